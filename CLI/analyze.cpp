@@ -5,18 +5,88 @@
 // license at https://github.com/stephenbensley/FiveFieldKono/blob/main/LICENSE.
 //
 
+#include "Cache.h"
 #include "Retrograde.h"
 
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
 #include <iostream>
 
 int main(int argc, char* const argv[])
 {
-   Graph graph(5, 5, 0b10001'11111);
-   Retrograde retro(graph);
-   std::cout << "Starting analysis." << std::endl;
-   auto value = retro.analyze();
+   // Optional arguments select the algorithm, the number of threads,
+   // whether to only solve the nodes reachable from the start, whether to
+   // save a table of best moves, and whether to renumber the graph for
+   // locality.
+   auto algorithm = Retrograde::SWEEP;
+   auto num_threads = 0;
+   auto reachable_only = false;
+   auto best_moves = false;
+   auto renumber = false;
+   for (auto i = 1; i < argc; ++i) {
+      char* end;
+      auto value = std::strtol(argv[i], &end, 10);
+      if (std::strcmp(argv[i], "sweep") == 0) {
+         algorithm = Retrograde::SWEEP;
+      } else if (std::strcmp(argv[i], "lockstep") == 0) {
+         algorithm = Retrograde::LOCKSTEP;
+      } else if (std::strcmp(argv[i], "bitwise") == 0) {
+         algorithm = Retrograde::BITWISE;
+      } else if (std::strcmp(argv[i], "scc") == 0) {
+         algorithm = Retrograde::SCC;
+      } else if (std::strcmp(argv[i], "queue") == 0) {
+         algorithm = Retrograde::QUEUE;
+      } else if (std::strcmp(argv[i], "reachable") == 0) {
+         reachable_only = true;
+      } else if (std::strcmp(argv[i], "moves") == 0) {
+         best_moves = true;
+      } else if (std::strcmp(argv[i], "renumber") == 0) {
+         renumber = true;
+      } else if ((*end == '\0') && (value > 0) && (value <= 1024)) {
+         num_threads = static_cast<int>(value);
+      } else {
+         std::cerr << "usage: analyze [sweep|lockstep|bitwise|scc|queue] "
+                      "[threads] [reachable] [moves] [renumber]"
+                   << std::endl;
+         return 1;
+      }
+   }
+
+   Cache cache("cache", renumber);
+   auto graph = cache.graph(5, 5, 0b10001'11111);
+   Retrograde retro(*graph, num_threads, reachable_only);
+   std::cout << "Nodes to solve: " << retro.strategy().num_entries() << " of "
+             << graph->size() << '\n'
+             << "Starting analysis." << std::endl;
+   auto begin = std::chrono::steady_clock::now();
+   auto value = retro.analyze(algorithm);
+   std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - begin;
    std::cout << "Analysis complete.\n"
-             << "Value of start position: " << value << std::endl;
-   retro.strategy().save("strategy.dat");
+             << "Value of start position: " << value << '\n'
+             << "Elapsed time: " << elapsed.count() << " s" << std::endl;
+   if (algorithm == Retrograde::SCC) {
+      auto& stats = retro.component_stats();
+      std::cout << "Components: " << stats.components << '\n'
+                << "Single nodes: " << stats.single_nodes << '\n'
+                << "Nodes in cycles: " << stats.cyclic_nodes << '\n'
+                << "Largest component: " << stats.largest << '\n'
+                << "Time in cycles: " << stats.cyclic_seconds << " s\n"
+                << "Peak search memory: " << (stats.peak_bytes >> 20)
+                << " MB\n"
+                << "Component sizes:\n";
+      for (auto i = 0; i < static_cast<int>(stats.sizes.size()); ++i) {
+         if (stats.sizes[i] != 0) {
+            std::cout << "   [" << (int64_t(1) << i) << ", "
+                      << (int64_t(1) << (i + 1)) << "): " << stats.sizes[i]
+                      << '\n';
+         }
+      }
+   }
+   if (best_moves) {
+      retro.add_best_moves();
+   }
+   cache.save(retro.strategy());
    return 0;
 }
@@ -0,0 +1,56 @@
+//
+// Copyright 2023 Stephen E. Bensley
+//
+// This file is licensed under the MIT License. You may obtain a copy of the
+// license at https://github.com/stephenbensley/FiveFieldKono/blob/main/LICENSE.
+//
+
+#include "BitMatrix.h"
+
+BitMatrix::BitMatrix(int rows, int cols)
+: rows_(rows),
+  cols_(cols),
+  words_per_row_((cols + 63) / 64),
+  bits_(static_cast<size_t>(block_rows()) * block_size * words_per_row_)
+{ }
+
+void BitMatrix::transpose(const BitMatrix& src, int first, int last) noexcept
+{
+   assert(rows_ == src.cols_);
+   assert(cols_ == src.rows_);
+
+   uint64_t block[block_size];
+   for (auto i = first; i < last; ++i) {
+      for (auto j = 0; j < src.words_per_row_; ++j) {
+         uint64_t any = 0;
+         for (auto k = 0; k < block_size; ++k) {
+            block[k] = src.row(i * block_size + k)[j];
+            any |= block[k];
+         }
+         // Sparse matrices have lots of empty blocks, which are their own
+         // transpose.
+         if (any != 0) {
+            transpose_block(block);
+         }
+         for (auto k = 0; k < block_size; ++k) {
+            row(j * block_size + k)[i] = block[k];
+         }
+      }
+   }
+}
+
+void transpose_block(uint64_t block[BitMatrix::block_size]) noexcept
+{
+   // Swap the off-diagonal quadrants, then the off-diagonal quadrants of each
+   // quadrant, and so on down to single bits.
+   constexpr auto size = BitMatrix::block_size;
+   uint64_t mask = 0x00000000ffffffff;
+   for (auto width = size / 2; width != 0; width >>= 1, mask ^= mask << width) {
+      // Visits every row whose bit for width is clear.
+      for (auto k = 0; k < size; k = ((k | width) + 1) & ~width) {
+         auto t = ((block[k] >> width) ^ block[k | width]) & mask;
+         block[k] ^= t << width;
+         block[k | width] ^= t;
+      }
+   }
+}
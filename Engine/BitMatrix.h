@@ -0,0 +1,100 @@
+//
+// Copyright 2023 Stephen E. Bensley
+//
+// This file is licensed under the MIT License. You may obtain a copy of the
+// license at https://github.com/stephenbensley/FiveFieldKono/blob/main/LICENSE.
+//
+
+#ifndef BitMatrix_h
+#define BitMatrix_h
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Dense matrix of bits stored row by row. Each row is padded to a whole
+// number of 64-bit words, and the number of rows is padded to a multiple of
+// 64, so the matrix can be transposed in 64x64 blocks. Padding bits are
+// zero initially, but aren't otherwise maintained.
+class BitMatrix
+{
+public:
+   // Number of rows or columns in a block.
+   static constexpr int block_size = 64;
+
+   BitMatrix() = default;
+   BitMatrix(int rows, int cols);
+
+   int rows() const noexcept;
+   int cols() const noexcept;
+   // Number of words in each row.
+   int words_per_row() const noexcept;
+   // Number of rows of blocks including padding.
+   int block_rows() const noexcept;
+
+   uint64_t* row(int index) noexcept;
+   const uint64_t* row(int index) const noexcept;
+   bool test(int row, int col) const noexcept;
+   void set(int row, int col) noexcept;
+
+   // Writes the transpose of blocks [first, last) of src's block rows to
+   // this matrix, which must have src's dimensions swapped. Different block
+   // rows write different words, so they can be transposed concurrently.
+   void transpose(const BitMatrix& src, int first, int last) noexcept;
+
+private:
+   int rows_ = 0;
+   int cols_ = 0;
+   int words_per_row_ = 0;
+   std::vector<uint64_t> bits_;
+};
+
+// Transposes a 64x64 block in place. Bit j of word i is element (i, j).
+void transpose_block(uint64_t block[BitMatrix::block_size]) noexcept;
+
+inline int BitMatrix::rows() const noexcept
+{
+   return rows_;
+}
+
+inline int BitMatrix::cols() const noexcept
+{
+   return cols_;
+}
+
+inline int BitMatrix::words_per_row() const noexcept
+{
+   return words_per_row_;
+}
+
+inline int BitMatrix::block_rows() const noexcept
+{
+   return (rows_ + block_size - 1) / block_size;
+}
+
+inline uint64_t* BitMatrix::row(int index) noexcept
+{
+   assert(index < block_rows() * block_size);
+   return bits_.data() + static_cast<size_t>(index) * words_per_row_;
+}
+
+inline const uint64_t* BitMatrix::row(int index) const noexcept
+{
+   assert(index < block_rows() * block_size);
+   return bits_.data() + static_cast<size_t>(index) * words_per_row_;
+}
+
+inline bool BitMatrix::test(int row, int col) const noexcept
+{
+   assert(col < cols_);
+   return (this->row(row)[col / 64] >> (col % 64)) & 1;
+}
+
+inline void BitMatrix::set(int row, int col) noexcept
+{
+   assert(col < cols_);
+   this->row(row)[col / 64] |= uint64_t(1) << (col % 64);
+}
+
+#endif /* BitMatrix_h */
@@ -7,6 +7,7 @@
 
 #include "Board.h"
 #include <algorithm>
+#include <bit>
 #include <cassert>
 #include <limits>
 
@@ -68,38 +69,95 @@ int distance(const Cells& lhs, const Cells& rhs) noexcept
 {
    assert(lhs.size() == rhs.size());
 
-   // Set of indices to permute.
-   std::vector<int> indices;
-   // 2D matrix of distances from each cell on the lhs to each cell on the rhs.
-   std::vector<std::vector<int>> distances(lhs.size());
-
-   for (auto i = 0; i < lhs.size(); ++i) {
-      indices.push_back(i);
-      for (auto j = 0; j < rhs.size(); ++j) {
-         distances[i].push_back(distance(lhs[i], rhs[j]));
-      }
+   // Finding the pairing of cells with the shortest total distance is the
+   // assignment problem, so we use the Hungarian algorithm, which is O(n^3).
+   // Rows are lhs cells and columns are rhs cells. Both are 1-based, so that
+   // column 0 can serve as the starting point of each augmenting path.
+   constexpr auto infinity = std::numeric_limits<int>::max();
+   auto n = static_cast<int>(lhs.size());
+   // Potentials for each row and column.
+   std::vector<int> row_pot(n + 1), col_pot(n + 1);
+   // Row assigned to each column, or zero if the column is unassigned.
+   std::vector<int> assigned(n + 1);
+   // Previous column along the augmenting path.
+   std::vector<int> prev(n + 1);
+
+   for (auto row = 1; row <= n; ++row) {
+      // Find an augmenting path starting from the new row.
+      assigned[0] = row;
+      auto col = 0;
+      std::vector<int> slack(n + 1, infinity);
+      std::vector<bool> visited(n + 1, false);
+      do {
+         visited[col] = true;
+         auto i = assigned[col];
+         auto delta = infinity;
+         auto next = 0;
+         for (auto j = 1; j <= n; ++j) {
+            if (visited[j]) {
+               continue;
+            }
+            auto cost = distance(lhs[i - 1], rhs[j - 1]) - row_pot[i] -
+                        col_pot[j];
+            if (cost < slack[j]) {
+               slack[j] = cost;
+               prev[j] = col;
+            }
+            if (slack[j] < delta) {
+               delta = slack[j];
+               next = j;
+            }
+         }
+         for (auto j = 0; j <= n; ++j) {
+            if (visited[j]) {
+               row_pot[assigned[j]] += delta;
+               col_pot[j] -= delta;
+            } else {
+               slack[j] -= delta;
+            }
+         }
+         col = next;
+      } while (assigned[col] != 0);
+
+      // Flip the assignments along the path.
+      do {
+         auto next = prev[col];
+         assigned[col] = assigned[next];
+         col = next;
+      } while (col != 0);
    }
 
-   // Iterate through all permutations and find out which one yields the
-   // shortest total distance.
-   auto result = std::numeric_limits<int>::max();
-   do {
-      auto total = 0;
-      for (auto i = 0; i < lhs.size(); ++i) {
-         total += distances[i][indices[i]];
-      }
-      result = std::min(result, total);
-   } while (std::next_permutation(indices.begin(), indices.end()));
-
+   auto result = 0;
+   for (auto j = 1; j <= n; ++j) {
+      result += distance(lhs[assigned[j] - 1], rhs[j - 1]);
+   }
    return result;
 }
 
 Board::Board(int width, int height) noexcept
-: width_(width), height_(height)
+: width_(width), height_(height), neighbors_()
 {
    assert(width_ > 0);
    assert(height_ > 0);
    assert(width_ * height_ <= max_cells);
+
+   for (auto color : { BLACK, WHITE }) {
+      for (auto i = 0; i < num_cells(color); ++i) {
+         auto from = cell(color, i);
+         // Same order as Cell::neighbors
+         Cell to[max_neighbors] = {
+            { from.x - 1, from.y - 1 },
+            { from.x - 1, from.y + 1 },
+            { from.x + 1, from.y - 1 },
+            { from.x + 1, from.y + 1 }
+         };
+         for (auto j = 0; j < max_neighbors; ++j) {
+            if (!out_of_bounds(to[j])) {
+               neighbors_[color][i][j] = 1 << color_ordinal(to[j]);
+            }
+         }
+      }
+   }
 }
 
 int Board::num_cells() const noexcept
@@ -271,6 +329,25 @@ ColorBitBoards Board::moves(const Cells& from) const
    return result;
 }
 
+int Board::moves(Color color,
+                 ColorBitBoard from,
+                 ColorBitBoard blocked,
+                 ColorMoves& result) const noexcept
+{
+   auto occupied = from | blocked;
+   auto count = 0;
+   // Iterate through the pieces from lowest ordinal to highest.
+   for (uint32_t pieces = from; pieces != 0; pieces &= pieces - 1) {
+      auto ordinal = std::countr_zero(pieces);
+      for (auto neighbor : neighbors_[color][ordinal]) {
+         if ((neighbor != 0) && ((neighbor & occupied) == 0)) {
+            result[count++] = from ^ (1 << ordinal) ^ neighbor;
+         }
+      }
+   }
+   return count;
+}
+
 std::vector<std::vector<int>> generate_combos(int n, int k)
 {
    assert(n > 0);
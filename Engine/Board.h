@@ -11,9 +11,10 @@
 #include <array>
 #include <vector>
 
-// This code is only used for graph generation; it is not in the hot path
-// during search. Therefore, the code has been optimized for readability and
-// simplicity -- not performance.
+// Most of this code is only used for graph generation; it is not in the hot
+// path during search. Therefore, the code has been optimized for readability
+// and simplicity -- not performance. The exception is the ColorBitBoard
+// version of Board::moves, which is fast enough to use during search.
 
 constexpr int num_players = 2;
 
@@ -41,6 +42,16 @@ using ColorBitBoard = uint16_t;
 using ColorBitBoards = std::vector<ColorBitBoard>;
 using ColorPosition = std::array<ColorBitBoard, num_players>;
 
+// Since ColorBitBoard is a uint16_t, a color can't have more than 16 cells.
+constexpr int max_color_cells = 16;
+
+// Every cell has at most four diagonal neighbors.
+constexpr int max_neighbors = 4;
+
+// Fixed-capacity buffer big enough to hold all the moves from any
+// ColorBitBoard.
+using ColorMoves = std::array<ColorBitBoard, max_color_cells * max_neighbors>;
+
 bool contains(const ColorBitBoards& boards, ColorBitBoard board) noexcept;
 
 class Cell;
@@ -124,10 +135,22 @@ public:
    // Returns all legal board positions that can be reached from the given
    // cells in a single move.
    ColorBitBoards moves(const Cells& from) const;
+   // Same as above, but works directly on bitboards and doesn't allocate.
+   // Pieces can't move onto any cells set in blocked. Moves are written to
+   // result in the same order as above, and the number of moves is returned.
+   int moves(Color color,
+             ColorBitBoard from,
+             ColorBitBoard blocked,
+             ColorMoves& result) const noexcept;
 
 private:
    int width_;
    int height_;
+   // Diagonal neighbors of every cell indexed by color and color ordinal.
+   // Each neighbor is a single bit in the same order as Cell::neighbors, or
+   // zero if the neighbor is off the board.
+   using Neighbors = std::array<ColorBitBoard, max_neighbors>;
+   std::array<std::array<Neighbors, max_color_cells>, num_colors> neighbors_;
 };
 
 // Helper function to generate all possible combinations C(n, k). Useful for
@@ -0,0 +1,332 @@
+//
+// Copyright 2023 Stephen E. Bensley
+//
+// This file is licensed under the MIT License. You may obtain a copy of the
+// license at https://github.com/stephenbensley/FiveFieldKono/blob/main/LICENSE.
+//
+
+#include "Cache.h"
+#include "Serialize.h"
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+
+// "FFKC" when read in little-endian byte order.
+constexpr uint32_t artifact_magic = 0x434b4646;
+// Incremented whenever the artifact format changes.
+constexpr uint32_t artifact_version = 1;
+// Strategies start on a page boundary, so they map efficiently.
+constexpr uint64_t strategy_alignment = 4096;
+
+std::string serialize(const Graph& graph)
+{
+   std::ostringstream ostrm;
+   graph.save(ostrm);
+   return ostrm.str();
+}
+
+BitBoard get_start0(const Graph& graph) noexcept
+{
+   return graph.start().position(graph.board())[0];
+}
+
+Cache::Cache(const char* directory, bool renumber)
+: directory_(directory),
+  renumber_(renumber)
+{ }
+
+std::unique_ptr<Graph> Cache::graph(int width,
+                                    int height,
+                                    BitBoard start0) const
+{
+   std::ifstream istrm(path(width, height, start0), std::ios::binary);
+   Header header;
+   if (read_header(istrm, width, height, start0, header)) {
+      auto graph = read_graph(istrm, header, width, height);
+      if (graph && renumber_ && !graph->renumbered()) {
+         graph = renumber_artifact(*graph, istrm, header);
+      }
+      if (graph) {
+         return graph;
+      }
+   }
+
+   // Either the graph isn't cached or the artifact is invalid, so build it
+   // from scratch.
+   auto graph = std::make_unique<Graph>(width, height, start0);
+   if (renumber_) {
+      graph->renumber();
+   }
+   write_artifact(*graph, nullptr);
+   return graph;
+}
+
+bool Cache::load(Strategy& strategy) const
+{
+   std::ifstream istrm;
+   Header header;
+   if (!open_strategy(strategy.graph(), istrm, header)) {
+      return false;
+   }
+
+   auto cached = layout(header);
+   auto current = strategy.layout();
+   if ((cached.compact != current.compact) ||
+       (current.wide && !cached.wide) ||
+       (current.best_moves && !cached.best_moves)) {
+      return false;
+   }
+   if (cached.wide) {
+      strategy.widen();
+   }
+   if (cached.best_moves && !current.best_moves) {
+      strategy.add_best_moves();
+   }
+
+   istrm.seekg(header.strategy_offset);
+   return strategy.load(istrm) &&
+          (strategy.bytes() == header.strategy_bytes) &&
+          (strategy.hash() == header.strategy_hash);
+}
+
+std::unique_ptr<Strategy> Cache::map(const Graph& graph, bool prefetch) const
+{
+   std::ifstream istrm;
+   Header header;
+   if (!open_strategy(graph, istrm, header)) {
+      return nullptr;
+   }
+
+   auto strategy = Strategy::map(graph,
+                                 path(graph).c_str(),
+                                 header.strategy_offset,
+                                 layout(header),
+                                 prefetch);
+   if (!strategy || (strategy->bytes() != header.strategy_bytes)) {
+      return nullptr;
+   }
+   return strategy;
+}
+
+void Cache::save(const Strategy& strategy) const
+{
+   write_artifact(strategy.graph(), &strategy);
+}
+
+std::string Cache::path(int width, int height, BitBoard start0) const
+{
+   // Including the version means artifacts in an old format are simply
+   // never found.
+   uint32_t variant[] = {
+      artifact_version,
+      static_cast<uint32_t>(width),
+      static_cast<uint32_t>(height),
+      start0
+   };
+   char filename[32];
+   std::snprintf(filename,
+                 sizeof(filename),
+                 "%016llx.ffk",
+                 static_cast<unsigned long long>(hash_bytes(variant,
+                                                            sizeof(variant))));
+   return (std::filesystem::path(directory_) / filename).string();
+}
+
+std::string Cache::path(const Graph& graph) const
+{
+   return path(graph.board().width(),
+               graph.board().height(),
+               get_start0(graph));
+}
+
+std::unique_ptr<Graph> Cache::read_graph(std::istream& istrm,
+                                         const Header& header,
+                                         int width,
+                                         int height)
+{
+   std::string bytes(header.graph_bytes, '\0');
+   if (!istrm.read(bytes.data(), bytes.size()) ||
+       (hash_bytes(bytes.data(), bytes.size()) != header.graph_hash)) {
+      return nullptr;
+   }
+   std::istringstream graph_strm(bytes);
+   return Graph::load(graph_strm,
+                      width,
+                      height,
+                      (header.flags & flag_renumbered) != 0);
+}
+
+bool Cache::open_strategy(const Graph& graph,
+                          std::ifstream& istrm,
+                          Header& header) const
+{
+   istrm.open(path(graph), std::ios::binary);
+   if (!read_header(istrm,
+                    graph.board().width(),
+                    graph.board().height(),
+                    get_start0(graph),
+                    header)) {
+      return false;
+   }
+
+   // A strategy is only valid for the exact graph it was built from. The
+   // size of a compact strategy depends on its contents, so it's checked
+   // once the strategy is read.
+   auto bytes = serialize(graph);
+   auto cached = layout(header);
+   auto node_bytes = (cached.wide ? sizeof(Strategy::Entry16)
+                                  : sizeof(Strategy::Entry8)) +
+                     (cached.best_moves ? 1 : 0);
+   return (header.graph_bytes == bytes.size()) &&
+          (header.graph_hash == hash_bytes(bytes.data(), bytes.size())) &&
+          (header.strategy_bytes != 0) &&
+          (cached.compact ||
+           (header.strategy_bytes == node_bytes * graph.size()));
+}
+
+std::unique_ptr<Graph> Cache::renumber_artifact(const Graph& original,
+                                                std::istream& istrm,
+                                                const Header& header) const
+{
+   // Renumbering in place would lose the numbering the strategy follows, so
+   // read a second copy of the graph.
+   istrm.seekg(sizeof(Header));
+   auto graph = read_graph(istrm, header, header.width, header.height);
+   if (!graph) {
+      return nullptr;
+   }
+   graph->renumber();
+
+   // A strategy that fails to load or translate is dropped, just as load
+   // would reject it.
+   std::unique_ptr<Strategy> strategy;
+   if (header.strategy_bytes != 0) {
+      auto cached = create_strategy(original, layout(header));
+      istrm.seekg(header.strategy_offset);
+      if (cached->load(istrm) &&
+          (cached->bytes() == header.strategy_bytes) &&
+          (cached->hash() == header.strategy_hash)) {
+         strategy = create_strategy(*graph, layout(header));
+         if (!strategy->translate(*cached)) {
+            strategy.reset();
+         }
+      }
+   }
+
+   write_artifact(*graph, strategy.get());
+   return graph;
+}
+
+std::unique_ptr<Strategy> Cache::create_strategy(const Graph& graph,
+                                                 Strategy::Layout layout)
+{
+   // Loading replaces the set of a compact strategy, but the tables must
+   // have entries until then, or the best-move table looks absent.
+   auto strategy = layout.compact
+                 ? std::make_unique<Strategy>(graph, graph.reachable())
+                 : std::make_unique<Strategy>(graph);
+   if (layout.wide) {
+      strategy->widen();
+   }
+   if (layout.best_moves) {
+      strategy->add_best_moves();
+   }
+   return strategy;
+}
+
+Strategy::Layout Cache::layout(const Header& header) noexcept
+{
+   return {
+      (header.flags & flag_compact) != 0,
+      (header.flags & flag_wide) != 0,
+      (header.flags & flag_best_moves) != 0
+   };
+}
+
+uint32_t Cache::flags(const Strategy::Layout& layout) noexcept
+{
+   return (layout.compact ? flag_compact : 0) |
+          (layout.wide ? flag_wide : 0) |
+          (layout.best_moves ? flag_best_moves : 0);
+}
+
+bool Cache::read_header(std::istream& istrm,
+                        int width,
+                        int height,
+                        BitBoard start0,
+                        Header& header)
+{
+   if (!read(istrm, header)) {
+      return false;
+   }
+
+   // Find the file size, so we can make sure the sections fit.
+   auto begin = istrm.tellg();
+   istrm.seekg(0, std::ios::end);
+   uint64_t size = istrm.tellg();
+   istrm.seekg(begin);
+
+   return (header.magic == artifact_magic) &&
+          (header.version == artifact_version) &&
+          (header.width == static_cast<uint32_t>(width)) &&
+          (header.height == static_cast<uint32_t>(height)) &&
+          (header.start0 == start0) &&
+          ((header.flags & ~known_flags) == 0) &&
+          (header.graph_bytes <= size - sizeof(Header)) &&
+          (header.strategy_offset <= size) &&
+          (header.strategy_bytes <= size - header.strategy_offset);
+}
+
+void Cache::write_artifact(const Graph& graph, const Strategy* strategy) const
+{
+   auto bytes = serialize(graph);
+   Header header = {
+      artifact_magic,
+      artifact_version,
+      static_cast<uint32_t>(graph.board().width()),
+      static_cast<uint32_t>(graph.board().height()),
+      get_start0(graph),
+      0,
+      bytes.size(),
+      hash_bytes(bytes.data(), bytes.size()),
+      0,
+      0,
+      0
+   };
+   auto graph_end = sizeof(Header) + bytes.size();
+   if (graph.renumbered()) {
+      header.flags |= flag_renumbered;
+   }
+   if (strategy != nullptr) {
+      header.strategy_offset =
+         (graph_end + strategy_alignment - 1) / strategy_alignment *
+         strategy_alignment;
+      header.strategy_bytes = strategy->bytes();
+      header.strategy_hash = strategy->hash();
+      header.flags |= flags(strategy->layout());
+   }
+
+   // Write to a temporary file and then rename it, so that nobody ever sees
+   // a partially-written artifact.
+   std::error_code ec;
+   std::filesystem::create_directories(directory_, ec);
+   auto filename = path(graph);
+   auto temp = filename + ".tmp";
+   {
+      std::ofstream ostrm(temp, std::ios::binary | std::ios::trunc);
+      write(ostrm, header);
+      ostrm.write(bytes.data(), bytes.size());
+      if (strategy != nullptr) {
+         std::string padding(header.strategy_offset - graph_end, '\0');
+         ostrm.write(padding.data(), padding.size());
+         strategy->save(ostrm);
+      }
+      if (!ostrm) {
+         ostrm.close();
+         std::filesystem::remove(temp, ec);
+         return;
+      }
+   }
+   std::filesystem::rename(temp, filename, ec);
+}
@@ -0,0 +1,122 @@
+//
+// Copyright 2023 Stephen E. Bensley
+//
+// This file is licensed under the MIT License. You may obtain a copy of the
+// license at https://github.com/stephenbensley/FiveFieldKono/blob/main/LICENSE.
+//
+
+#ifndef Cache_h
+#define Cache_h
+
+#include "Strategy.h"
+#include <fstream>
+#include <memory>
+#include <string>
+
+// Caches graphs and strategies on disk, so they don't have to be rebuilt
+// every time. Each variant of the game is stored in a single artifact file
+// named after a hash of the variant. An artifact holds the serialized graph
+// and, optionally, the strategy for the graph.
+class Cache
+{
+public:
+   // If renumber is true, graphs are renumbered for locality. An artifact
+   // that predates renumbering is rewritten with the renumbered graph and
+   // its strategy translated to match the first time its graph is read.
+   Cache(const char* directory, bool renumber = false);
+
+   // Returns the graph for the variant, loading it from the cache if
+   // possible. Otherwise, the graph is built and added to the cache.
+   std::unique_ptr<Graph> graph(int width, int height, BitBoard start0) const;
+   // Loads the strategy for its graph. Returns false if the cache doesn't
+   // have a valid strategy for the graph, or if the cached strategy isn't
+   // compact when the strategy is, or vice versa. The strategy is widened
+   // and given a best-move table to match the cached one.
+   bool load(Strategy& strategy) const;
+   // Memory maps the strategy for the graph instead of loading it. Unlike
+   // load, the strategy's contents aren't hashed, since that would read the
+   // whole thing. Returns nullptr if the cache doesn't have a strategy for
+   // the graph.
+   std::unique_ptr<Strategy> map(const Graph& graph,
+                                 bool prefetch = false) const;
+   // Saves the strategy along with its graph.
+   void save(const Strategy& strategy) const;
+
+   // Returns the path of the artifact for the variant.
+   std::string path(int width, int height, BitBoard start0) const;
+
+private:
+   // Stored at the start of every artifact. The graph immediately follows
+   // the header. The strategy, if any, starts at strategy_offset.
+   struct Header {
+      // Identifies the file as an artifact with the expected byte order.
+      uint32_t magic;
+      // Incremented whenever the format changes.
+      uint32_t version;
+      // Variant stored in the artifact.
+      uint32_t width;
+      uint32_t height;
+      uint32_t start0;
+      // Combination of the flag_* values. Other bits must be zero.
+      uint32_t flags;
+      // Size and hash of the serialized graph.
+      uint64_t graph_bytes;
+      uint64_t graph_hash;
+      // Location, size, and hash of the strategy. Size is zero if the
+      // artifact doesn't contain a strategy.
+      uint64_t strategy_offset;
+      uint64_t strategy_bytes;
+      uint64_t strategy_hash;
+   };
+
+   // Set if the strategy only stores the nodes reachable from the start.
+   static constexpr uint32_t flag_compact = 1;
+   // Set if the strategy has 16-bit entries instead of 8-bit.
+   static constexpr uint32_t flag_wide = 2;
+   // Set if the strategy has a table of best moves.
+   static constexpr uint32_t flag_best_moves = 4;
+   // Set if the graph has been renumbered. It's saved with its original
+   // indices, and the strategy follows the new ones.
+   static constexpr uint32_t flag_renumbered = 8;
+   static constexpr uint32_t known_flags =
+      flag_compact | flag_wide | flag_best_moves | flag_renumbered;
+
+   // Converts between the header's flags and the strategy's layout.
+   static Strategy::Layout layout(const Header& header) noexcept;
+   static uint32_t flags(const Strategy::Layout& layout) noexcept;
+   // Returns the path of the artifact for the graph's variant.
+   std::string path(const Graph& graph) const;
+   // Reads the artifact's header and checks that it's for the variant.
+   static bool read_header(std::istream& istrm,
+                           int width,
+                           int height,
+                           BitBoard start0,
+                           Header& header);
+   // Reads the graph that follows the header. Returns nullptr if it's
+   // invalid.
+   static std::unique_ptr<Graph> read_graph(std::istream& istrm,
+                                            const Header& header,
+                                            int width,
+                                            int height);
+   // Opens the artifact and checks that it has a strategy for the graph.
+   bool open_strategy(const Graph& graph,
+                      std::ifstream& istrm,
+                      Header& header) const;
+   // Given the graph read from an artifact that predates renumbering,
+   // returns it renumbered and rewrites the artifact to match, translating
+   // the strategy, if any. Returns nullptr if the artifact is invalid.
+   std::unique_ptr<Graph> renumber_artifact(const Graph& original,
+                                            std::istream& istrm,
+                                            const Header& header) const;
+   // Creates an empty strategy for the graph with the given layout, ready
+   // to be loaded.
+   static std::unique_ptr<Strategy> create_strategy(const Graph& graph,
+                                                    Strategy::Layout layout);
+   // Writes a new artifact for the graph and, if non-null, its strategy.
+   void write_artifact(const Graph& graph, const Strategy* strategy) const;
+
+   std::string directory_;
+   bool renumber_;
+};
+
+#endif /* Cache_h */
@@ -6,6 +6,9 @@
 //
 
 #include "ColorGraph.h"
+#include "Parallel.h"
+#include "Serialize.h"
+#include <array>
 
 uint32_t concat(uint16_t upper, uint16_t lower) noexcept
 {
@@ -13,15 +16,36 @@ uint32_t concat(uint16_t upper, uint16_t lower) noexcept
           static_cast<uint32_t>(lower);
 }
 
-bool contains(const ColorNodes& nodes, const ColorNode* node) noexcept
+// Ranks the pieces using the combinatorial number system, ignoring any cells
+// that are set in skip.
+int rank_pieces(ColorBitBoard pieces, ColorBitBoard skip) noexcept
 {
-   return std::find(nodes.begin(), nodes.end(), node) != nodes.end();
+   auto result = 0;
+   auto i = 0;
+   uint32_t remaining = pieces;
+   while (remaining != 0) {
+      auto lowest = remaining & (~remaining + 1);
+      // Number of unskipped cells below this piece.
+      auto cell = count_set_bits((lowest - 1) & ~skip);
+      result += binomial(cell, ++i);
+      remaining ^= lowest;
+   }
+   return result;
 }
 
+ColorGraph::ColorGraph() noexcept
+: num_pieces_(0),
+  num_p1_ranks_(0),
+  start_index_(0)
+{ }
+
 ColorGraph::ColorGraph(const Board& board,
                        Color color,
                        ColorPosition start)
-: num_pieces_(count_set_bits(start[0]))
+: num_pieces_(count_set_bits(start[0])),
+  num_p1_ranks_(binomial(board.num_cells(color) - num_pieces_, num_pieces_)),
+  index_(binomial(board.num_cells(color), num_pieces_) * num_p1_ranks_,
+         no_node)
 {
 
    auto goal0_bits = start[1];
@@ -33,9 +57,10 @@ ColorGraph::ColorGraph(const Board& board,
    assert(goal1_cells.size() == num_pieces_);
 
    auto positions = build_positions(board, color, goal0_cells, goal1_cells);
-   build_nodes(positions, goal0_bits, goal1_bits);
-   populate_moves(positions);
-   start_index_ = index_[concat(goal1_bits, goal0_bits)];
+   auto combos = build_nodes(positions, goal0_bits, goal1_bits);
+   populate_moves(positions, combos);
+   start_index_ = index_[rank(goal1_bits, goal0_bits)];
+   build_columns();
 }
 
 const ColorNode* ColorGraph::node(ColorBitBoard p0,
@@ -45,9 +70,138 @@ const ColorNode* ColorGraph::node(ColorBitBoard p0,
    assert(count_set_bits(p0) == num_pieces_);
    assert(count_set_bits(p1) == num_pieces_);
 
-   auto i = index_.find(concat(p0, p1));
-   assert (i != index_.end());
-   return &nodes_[i->second];
+   auto index = index_[rank(p0, p1)];
+   assert(index != no_node);
+   return &nodes_[index];
+}
+
+bool ColorGraph::load(std::istream& istrm, bool renumbered)
+{
+   uint64_t num_nodes;
+   if (!read(istrm, num_pieces_) ||
+       !read(istrm, num_p1_ranks_) ||
+       !read(istrm, start_index_) ||
+       !read(istrm, num_nodes) ||
+       (num_nodes > no_node)) {
+      return false;
+   }
+
+   nodes_.resize(num_nodes);
+   for (auto i = 0; i < size(); ++i) {
+      nodes_[i].index = i;
+      for (auto& player : nodes_[i].player) {
+         if (!read(istrm, player.pieces) ||
+             !read(istrm, player.goal_reached) ||
+             !read(istrm, player.goal_full) ||
+             !read(istrm, player.distance) ||
+             !read(istrm, player.num_moves) ||
+             !read(istrm, player.num_unmoves)) {
+            return false;
+         }
+      }
+   }
+
+   if (!read(istrm, edges_) || !read(istrm, index_)) {
+      return false;
+   }
+   order_.clear();
+   if (renumbered && !read(istrm, order_)) {
+      return false;
+   }
+
+   // Make sure nothing points outside the graph before we trust it.
+   size_t offset = 0;
+   for (auto& node : nodes_) {
+      node.edges = edges_.data() + offset;
+      for (auto& player : node.player) {
+         offset += player.num_moves + player.num_unmoves;
+      }
+   }
+   auto in_range = [this](auto index) { return index < nodes_.size(); };
+   auto in_index = [&](auto index) {
+      return (index == no_node) || in_range(index);
+   };
+   if ((offset != edges_.size()) ||
+       (start_index_ < 0) || (start_index_ >= size()) ||
+       !std::all_of(edges_.begin(), edges_.end(), in_range) ||
+       !std::all_of(index_.begin(), index_.end(), in_index)) {
+      return false;
+   }
+   if (renumbered) {
+      // Must be a permutation of the original indices.
+      std::vector<bool> seen(nodes_.size());
+      for (auto index : order_) {
+         if (!in_range(index) || seen[index]) {
+            return false;
+         }
+         seen[index] = true;
+      }
+      if (order_.size() != nodes_.size()) {
+         return false;
+      }
+   }
+
+   build_columns();
+   return true;
+}
+
+void ColorGraph::save(std::ostream& ostrm) const
+{
+   write(ostrm, num_pieces_);
+   write(ostrm, num_p1_ranks_);
+   write(ostrm, start_index_);
+   write(ostrm, static_cast<uint64_t>(nodes_.size()));
+   // The edges pointer is rebuilt on load, so write the fields one by one.
+   for (auto& node : nodes_) {
+      for (auto& player : node.player) {
+         write(ostrm, player.pieces);
+         write(ostrm, player.goal_reached);
+         write(ostrm, player.goal_full);
+         write(ostrm, player.distance);
+         write(ostrm, player.num_moves);
+         write(ostrm, player.num_unmoves);
+      }
+   }
+   write(ostrm, edges_);
+   write(ostrm, index_);
+   if (renumbered()) {
+      write(ostrm, order_);
+   }
+}
+
+void ColorGraph::renumber()
+{
+   std::vector<uint16_t> order;
+   order.reserve(nodes_.size());
+   std::vector<bool> visited(nodes_.size());
+   auto visit = [&](int index) {
+      if (!visited[index]) {
+         visited[index] = true;
+         order.push_back(index);
+      }
+   };
+
+   // The order itself is the queue. Searches after the first pick up any
+   // nodes that can't reach or be reached from the start.
+   auto search = [&](int root) {
+      auto head = order.size();
+      visit(root);
+      for (; head < order.size(); ++head) {
+         auto first = edge_offsets_[order[head]];
+         auto last = edge_offsets_[order[head] + 1];
+         for (auto i = first; i < last; ++i) {
+            visit(edges_[i]);
+         }
+      }
+   };
+   search(start_index_);
+   for (auto i = 0; i < size(); ++i) {
+      if (!visited[i]) {
+         search(i);
+      }
+   }
+
+   permute(order);
 }
 
 ColorGraph::Positions ColorGraph::build_positions(const Board& board,
@@ -59,15 +213,17 @@ ColorGraph::Positions ColorGraph::build_positions(const Board& board,
    // number of pieces for each player.
    auto combos = generate_combos(board.num_cells(color),
                                  static_cast<int>(goal0.size()));
-   Positions result;
-   for (auto& combo : combos) {
+   Positions result(combos.size());
+   parallel_for(0, static_cast<int>(combos.size()), [&](int i) {
       // Collect the cells for the combination.
       Cells cells;
-      for (auto index : combo) {
+      for (auto index : combos[i]) {
          cells.push_back(board.cell(color, index));
       }
 
       auto pieces = board.color_bitboard(cells);
+      ColorMoves moves;
+      auto num_moves = board.moves(color, pieces, 0, moves);
       auto reflected = pieces;
       // Can only reflect odd-width boards.
       if (board.width() % 2) {
@@ -75,14 +231,14 @@ ColorGraph::Positions ColorGraph::build_positions(const Board& board,
       }
       
       // Add the new Position.
-      result.push_back({
+      result[i] = {
          pieces,
          reflected,
          { static_cast<short>(distance(cells, goal0)),
            static_cast<short>(distance(cells, goal1)) },
-         board.moves(cells)
-      });
-   }
+         { moves.begin(), moves.begin() + num_moves }
+      };
+   });
    return result;
 }
 
@@ -92,7 +248,8 @@ std::pair<uint32_t, uint32_t> ColorGraph::get_keys(const Position& p0,
    return { concat(p0.pieces, p1.pieces), concat(p0.reflected, p1.reflected) };
 }
 
-bool ColorGraph::is_valid_combo(const Position& p0, const Position& p1) noexcept
+bool ColorGraph::is_valid_combo(const Position& p0,
+                                const Position& p1) const noexcept
 {
    assert(count_set_bits(p0.pieces) == num_pieces_);
    assert(count_set_bits(p1.pieces) == num_pieces_);
@@ -121,96 +278,247 @@ ColorNode ColorGraph::build_node(uint16_t index,
             p0.pieces,
             (p0.pieces & goal0) != 0,
             (all_pieces & goal0) == goal0,
-            p0.distance[0]
+            p0.distance[0],
+            0,
+            0
          },
          {
             p1.pieces,
             (p1.pieces & goal1) != 0,
             (all_pieces & goal1) == goal1,
-            p1.distance[1]
+            p1.distance[1],
+            0,
+            0
          }
-      }
-   }};
+      }},
+      nullptr
+   };
 }
 
-void ColorGraph::build_nodes(const Positions& positions,
-                             ColorBitBoard goal0,
-                             ColorBitBoard goal1)
+ColorGraph::Combos ColorGraph::build_nodes(const Positions& positions,
+                                          ColorBitBoard goal0,
+                                          ColorBitBoard goal1)
 {
-   for (auto p0 : positions) {
-      for (auto p1 : positions) {
-         if (!is_valid_combo(p0, p1)) {
-            continue;;
+   auto num_positions = static_cast<int>(positions.size());
+
+   // Find the valid combos for each p0 in parallel ...
+   std::vector<std::vector<int>> valid(num_positions);
+   parallel_for(0, num_positions, [&](int i) {
+      for (auto j = 0; j < num_positions; ++j) {
+         if (is_valid_combo(positions[i], positions[j])) {
+            valid[i].push_back(j);
          }
-         // Index is the same as the node's position in the vector.
-         auto index = static_cast<int>(nodes_.size());
-         nodes_.push_back(build_node(index, p0, p1, goal0, goal1));
+      }
+   });
 
-         // Index the node both ways, so that both this combo and its
-         // reflection map to the same node.
-         auto [p_key, r_key] = get_keys(p0, p1);
-         index_[p_key] = index;
-         index_[r_key] = index;
+   // ... then number them in order, so the indices don't depend on how the
+   // work was scheduled.
+   Combos result;
+   for (auto i = 0; i < num_positions; ++i) {
+      for (auto j : valid[i]) {
+         result.push_back({ i, j });
       }
    }
+   // Every index, and none of them no_node, must fit in 16 bits.
+   assert(result.size() <= no_node);
+
+   nodes_.resize(result.size());
+   parallel_for(0, static_cast<int>(result.size()), [&](int index) {
+      auto& p0 = positions[result[index].first];
+      auto& p1 = positions[result[index].second];
+      // Index is the same as the node's position in the vector.
+      nodes_[index] = build_node(index, p0, p1, goal0, goal1);
+
+      // Index the node both ways, so that both this combo and its
+      // reflection map to the same node. No other node shares these ranks,
+      // so the writes can't collide.
+      index_[rank(p0.pieces, p1.pieces)] = index;
+      index_[rank(p0.reflected, p1.reflected)] = index;
+   });
+
+   return result;
+}
+
+int ColorGraph::rank(ColorBitBoard p0, ColorBitBoard p1) const noexcept
+{
+   assert((p0 & p1) == 0);
+
+   // Player 1's pieces can't be on any of the cells occupied by player 0.
+   return rank_pieces(p0, 0) * num_p1_ranks_ + rank_pieces(p1, p0);
 }
 
 ColorNode* ColorGraph::find(ColorBitBoard p0, ColorBitBoard p1) noexcept
 {
-   auto i = index_.find(concat(p0, p1));
-   assert (i != index_.end());
-   return &nodes_[i->second];
+   auto index = index_[rank(p0, p1)];
+   assert(index != no_node);
+   return &nodes_[index];
 }
 
-ColorNodes ColorGraph::build_p0_moves(const Position& p0,
-                                      const Position& p1)
+std::vector<uint16_t> ColorGraph::build_p0_moves(const Position& p0,
+                                                 const Position& p1)
 {
-   ColorNodes result;
+   std::vector<uint16_t> result;
    for (auto move : p0.moves) {
       if ((move & p1.pieces) == 0) {
          auto node = find(move, p1.pieces);
          // Since we're consolidating equivalent positions, this move may
          // already be in the vector.
-         if (!contains(result, node)) {
-            result.push_back(node);
+         if (!contains(result, node->index)) {
+            result.push_back(node->index);
          }
       }
    }
    return result;
 }
 
-ColorNodes ColorGraph::build_p1_moves(const Position& p0,
-                                      const Position& p1)
+std::vector<uint16_t> ColorGraph::build_p1_moves(const Position& p0,
+                                                 const Position& p1)
 {
-   ColorNodes result;
+   std::vector<uint16_t> result;
    for (auto move : p1.moves) {
        if ((move & p0.pieces) == 0) {
          auto node = find(p0.pieces, move);
-         if (!contains(result, node)) {
-            result.push_back(node);
+         if (!contains(result, node->index)) {
+            result.push_back(node->index);
          }
       }
    }
    return result;
 }
 
-void ColorGraph::build_moves(ColorNode& dst,
-                             const Position& p0,
-                             const Position& p1)
+ColorGraph::Edges ColorGraph::build_moves(const Position& p0,
+                                          const Position& p1)
 {
-   dst.player[0].moves = build_p0_moves(p0, p1);
-   dst.player[1].moves = build_p1_moves(p0, p1);
+   return { build_p0_moves(p0, p1), build_p1_moves(p0, p1) };
 }
 
-void ColorGraph::populate_moves(const Positions& positions)
+void ColorGraph::populate_moves(const Positions& positions,
+                                const Combos& combos)
 {
-   for (auto p0 : positions) {
-      for (auto p1 : positions) {
-         if (is_valid_combo(p0, p1)) {
-            build_moves(*find(p0.pieces, p1.pieces), p0, p1);
+   std::vector<Edges> moves(nodes_.size());
+   parallel_for(0, size(), [&](int index) {
+      moves[index] = build_moves(positions[combos[index].first],
+                                 positions[combos[index].second]);
+   });
+
+   // Unmoves are simply the moves reversed. Move lists never contain
+   // duplicates, so neither will these.
+   std::vector<Edges> unmoves(nodes_.size());
+   for (auto i = 0; i < size(); ++i) {
+      for (auto j = 0; j < num_players; ++j) {
+         for (auto move : moves[i][j]) {
+            unmoves[move][j].push_back(i);
          }
       }
    }
+
+   pack_edges(moves, unmoves);
+}
+
+void ColorGraph::pack_edges(const std::vector<Edges>& moves,
+                            const std::vector<Edges>& unmoves)
+{
+   // Append each node's edges in the order expected by ColorNode.
+   std::vector<size_t> offsets;
+   for (auto& node : nodes_) {
+      offsets.push_back(edges_.size());
+      for (auto edges : { &moves[node.index], &unmoves[node.index] }) {
+         for (auto j = 0; j < num_players; ++j) {
+            edges_.insert(edges_.end(), (*edges)[j].begin(), (*edges)[j].end());
+         }
+      }
+      for (auto j = 0; j < num_players; ++j) {
+         node.player[j].num_moves = moves[node.index][j].size();
+         node.player[j].num_unmoves = unmoves[node.index][j].size();
+      }
+   }
+
+   // Now that the edge array won't be resized again, we can point into it.
+   for (auto& node : nodes_) {
+      node.edges = edges_.data() + offsets[node.index];
+   }
+}
+
+void ColorGraph::permute(const std::vector<uint16_t>& order)
+{
+   assert(order.size() == nodes_.size());
+   std::vector<uint16_t> inverse(nodes_.size());
+   for (auto i = 0; i < size(); ++i) {
+      inverse[order[i]] = i;
+   }
+
+   std::vector<ColorNode> nodes;
+   std::vector<uint16_t> edges;
+   nodes.reserve(nodes_.size());
+   edges.reserve(edges_.size());
+   for (auto index : order) {
+      nodes.push_back(nodes_[index]);
+      nodes.back().index = nodes.size() - 1;
+      auto first = edge_offsets_[index];
+      auto last = edge_offsets_[index + 1];
+      for (auto i = first; i < last; ++i) {
+         edges.push_back(inverse[edges_[i]]);
+      }
+   }
+   nodes_ = std::move(nodes);
+   edges_ = std::move(edges);
+   size_t offset = 0;
+   for (auto& node : nodes_) {
+      node.edges = edges_.data() + offset;
+      for (auto& player : node.player) {
+         offset += player.num_moves + player.num_unmoves;
+      }
+   }
+
+   for (auto& index : index_) {
+      if (index != no_node) {
+         index = inverse[index];
+      }
+   }
+   start_index_ = inverse[start_index_];
+
+   // Renumbering twice composes the permutations.
+   if (order_.empty()) {
+      order_ = order;
+   } else {
+      std::vector<uint16_t> original(order.size());
+      for (auto i = 0; i < size(); ++i) {
+         original[i] = order_[order[i]];
+      }
+      order_ = std::move(original);
+   }
+
+   build_columns();
+}
+
+void ColorGraph::build_columns()
+{
+   auto num_words = (nodes_.size() + 63) / 64;
+   for (auto j = 0; j < num_players; ++j) {
+      distances_[j].resize(nodes_.size());
+      num_moves_[j].resize(nodes_.size());
+      goal_reached_[j].assign(num_words, 0);
+      goal_full_[j].assign(num_words, 0);
+   }
+   edge_offsets_.resize(nodes_.size() + 1);
+
+   for (auto& node : nodes_) {
+      auto i = node.index;
+      auto bit = uint64_t(1) << (i % 64);
+      for (auto j = 0; j < num_players; ++j) {
+         auto& player = node.player[j];
+         distances_[j][i] = player.distance;
+         num_moves_[j][i] = player.num_moves;
+         if (player.goal_reached) {
+            goal_reached_[j][i / 64] |= bit;
+         }
+         if (player.goal_full) {
+            goal_full_[j][i / 64] |= bit;
+         }
+      }
+      edge_offsets_[i] = static_cast<uint32_t>(node.edges - edges_.data());
+   }
+   edge_offsets_.back() = static_cast<uint32_t>(edges_.size());
 }
 
 int count_set_bits(uint32_t src) noexcept
@@ -221,3 +529,25 @@ int count_set_bits(uint32_t src) noexcept
    src = (src & 0x33333333) + ((src >> 2) & 0x33333333);
    return ((src + (src >> 4) & 0xF0F0F0F) * 0x1010101) >> 24;
 }
+
+int binomial(int n, int k) noexcept
+{
+   constexpr int max_n = 16;
+   assert(n >= 0);
+   assert(n <= max_n);
+   assert(k >= 0);
+
+   // Pascal's triangle with enough rows for any ColorBitBoard.
+   static const auto table = [] {
+      std::array<std::array<int, max_n + 1>, max_n + 1> result = {};
+      for (auto i = 0; i <= max_n; ++i) {
+         result[i][0] = 1;
+         for (auto j = 1; j <= i; ++j) {
+            result[i][j] = result[i - 1][j - 1] + result[i - 1][j];
+         }
+      }
+      return result;
+   }();
+
+   return (k <= n) ? table[n][k] : 0;
+}
@@ -10,13 +10,45 @@
 
 #include "Board.h"
 #include <cassert>
-#include <unordered_map>
+#include <istream>
+#include <ostream>
 
 bool is_valid_player(int player) noexcept;
 int other_player(int player) noexcept;
 
-class ColorNode;
-using ColorNodes = std::vector<const ColorNode*>;
+struct ColorNode;
+
+// Lightweight view of a range of edges in a ColorGraph. Edges are stored as
+// 16-bit node indices, which are resolved against the graph's node array.
+class ColorEdges
+{
+public:
+   class Iterator
+   {
+   public:
+      Iterator(const ColorNode* nodes, const uint16_t* edge) noexcept;
+      const ColorNode* operator*() const noexcept;
+      Iterator& operator++() noexcept;
+      bool operator!=(const Iterator& rhs) const noexcept;
+
+   private:
+      const ColorNode* nodes_;
+      const uint16_t* edge_;
+   };
+
+   ColorEdges(const ColorNode* nodes, const uint16_t* first, int size) noexcept;
+   Iterator begin() const noexcept;
+   Iterator end() const noexcept;
+   bool empty() const noexcept;
+   int size() const noexcept;
+   const ColorNode* operator[](int index) const noexcept;
+
+private:
+   // Start of the graph's node array.
+   const ColorNode* nodes_;
+   const uint16_t* first_;
+   int size_;
+};
 
 // Represents a node in the per-color graph of the game, i.e., either the
 // black or the white graph.
@@ -33,23 +65,35 @@ struct ColorNode {
       // Number of moves required for the player to move all his pieces to
       // the goal, provided they are not blocked by the opponent.
       short distance;
-      // Valid moves for the player assuming none is blocked by the opponent.
-      ColorNodes moves;
+      // Number of edges returned by moves() and unmoves() for the player.
+      uint8_t num_moves;
+      uint8_t num_unmoves;
    };
 
    // Densely-packed integer [0,N) that uniquely identifies the node.
    uint16_t index;
    // Each player's state for the node.
    std::array<Player, num_players> player;
+   // The node's edges in the graph's edge array. The edges are stored in
+   // order: player 0's moves, player 1's moves, player 0's unmoves, and
+   // player 1's unmoves.
+   const uint16_t* edges;
    // The parity changes whenever a move is made. The parity of the node is
    // useful for determining whose turn it is.
    int parity() const noexcept;
+   // Valid moves for the player assuming none is blocked by the opponent.
+   ColorEdges moves(int idx) const noexcept;
+   // Nodes from which the player can move to this node, i.e., the reverse
+   // of moves(). Used for propagating results backwards.
+   ColorEdges unmoves(int idx) const noexcept;
 };
 
 // Represents the game graph for a given color
 class ColorGraph
 {
 public:
+   // Constructs an empty graph. Only useful as a target for load.
+   ColorGraph() noexcept;
    ColorGraph(const Board& board, Color color, ColorPosition start);
 
    // Starting position of the game.
@@ -61,7 +105,35 @@ public:
    // Returns the node at the given index.
    const ColorNode* operator[](int index) const noexcept;
 
+   // Copies of the ColorNode fields that whole-graph passes scan, stored
+   // column by column in node index order. Indexed by player.
+   const std::vector<short>& distances(int idx) const noexcept;
+   const std::vector<uint8_t>& num_moves(int idx) const noexcept;
+   // One bit per node, 64 nodes to a word.
+   const std::vector<uint64_t>& goal_reached(int idx) const noexcept;
+   const std::vector<uint64_t>& goal_full(int idx) const noexcept;
+
+   // Renumbers the nodes in breadth-first order from the start, following
+   // moves and unmoves of both players, so nodes a move apart get nearby
+   // indices. Nodes the search doesn't reach follow in their original
+   // order. The moves of each node keep their order.
+   void renumber();
+   // Returns true if the graph has been renumbered.
+   bool renumbered() const noexcept;
+   // Index the node had when the graph was built, before any renumbering.
+   int original_index(int index) const noexcept;
+
+   // Load/save the graph from/to a stream. load returns false if the stream
+   // doesn't contain a valid graph. A renumbered graph also saves its
+   // original indices, and must be loaded with renumbered set.
+   bool load(std::istream& istrm, bool renumbered = false);
+   void save(std::ostream& ostrm) const;
+
 private:
+   // Marks a rank that doesn't correspond to any node. Node indices must stay
+   // below it to fit in the 16-bit index and edge arrays.
+   static constexpr uint16_t no_node = 0xffff;
+
    // Used to store intermediate state about a position during graph
    // construction.
    struct Position {
@@ -75,6 +147,9 @@ private:
       ColorBitBoards moves;
    };
    using Positions = std::vector<Position>;
+   // Indices of the p0 and p1 Positions that make up each node, in node
+   // index order.
+   using Combos = std::vector<std::pair<int, int>>;
 
    // Builds a vector of all valid Positions.
    static Positions build_positions(const Board& board,
@@ -87,7 +162,7 @@ private:
                                                  const Position& p1) noexcept;
    // Returns true if the combination of the two positions can occur during
    // game play and isn't simply a reflection of another position.
-   bool is_valid_combo(const Position& p0, const Position& p1) noexcept;
+   bool is_valid_combo(const Position& p0, const Position& p1) const noexcept;
    // Populates all the fields in a ColorNode struct except the moves.
    static ColorNode build_node(uint16_t index,
                                const Position& p0,
@@ -95,42 +170,142 @@ private:
                                ColorBitBoard goal0,
                                ColorBitBoard goal1);
    // Builds all the ColorNodes that can be formed by combining positions.
-   void build_nodes(const Positions& positions,
-                    ColorBitBoard goal0,
-                    ColorBitBoard goal1);
+   Combos build_nodes(const Positions& positions,
+                      ColorBitBoard goal0,
+                      ColorBitBoard goal1);
+   // Returns a densely-packed integer [0, C(n,k) * C(n-k,k)) that uniquely
+   // identifies the combination of pieces, where n is the number of cells and
+   // k is the number of pieces per player.
+   int rank(ColorBitBoard p0, ColorBitBoard p1) const noexcept;
    // Returns the ColorNode corresponding to the specified positions.
    ColorNode* find(ColorBitBoard p0, ColorBitBoard p1) noexcept;
+   // Used to store a node's edges during graph construction. Edges are node
+   // indices indexed by player.
+   using Edges = std::array<std::vector<uint16_t>, num_players>;
    // Builds player 0's moves for the combo.
-   ColorNodes build_p0_moves(const Position& p0,
-                             const Position& p1);
+   std::vector<uint16_t> build_p0_moves(const Position& p0,
+                                        const Position& p1);
    // Builds player 1's moves for the combo.
-   ColorNodes build_p1_moves(const Position& p0,
-                             const Position& p1);
+   std::vector<uint16_t> build_p1_moves(const Position& p0,
+                                        const Position& p1);
    // Builds both players moves for the combo.
-   void build_moves(ColorNode& dst,
-                    const Position& p0,
-                    const Position& p1);
-   // Iterates through all the ColorNodes and initializes there moves field.
-   void populate_moves(const Positions& positions);
+   Edges build_moves(const Position& p0, const Position& p1);
+   // Iterates through all the ColorNodes and initializes their edges.
+   void populate_moves(const Positions& positions, const Combos& combos);
+   // Packs the moves and unmoves of every ColorNode into the edge array.
+   void pack_edges(const std::vector<Edges>& moves,
+                   const std::vector<Edges>& unmoves);
+   // Copies the ColorNodes into the columns.
+   void build_columns();
+   // Moves the node at order[i] to index i.
+   void permute(const std::vector<uint16_t>& order);
 
    // Number of pieces for each player.
    int num_pieces_;
+   // Number of ways to place player 1's pieces once player 0's are placed.
+   int num_p1_ranks_;
    // All the nodes in the graph in index order, so a ColorNode's index
    // represents its position in the vector.
    std::vector<ColorNode> nodes_;
-   // Maps keys to indices.
-   std::unordered_map<uint32_t, int> index_;
+   // Edges of all the nodes in compressed sparse row format.
+   std::vector<uint16_t> edges_;
+   // Maps the rank of a combination to the index of its node. Both a
+   // combination and its reflection map to the same node. Ranks of invalid
+   // combinations map to no_node.
+   std::vector<uint16_t> index_;
    // Starting node of the game.
    int start_index_;
+   // Original index of each node if the graph has been renumbered, else
+   // empty.
+   std::vector<uint16_t> order_;
+   // Columns derived from the nodes. See distances().
+   std::array<std::vector<short>, num_players> distances_;
+   std::array<std::vector<uint8_t>, num_players> num_moves_;
+   std::array<std::vector<uint64_t>, num_players> goal_reached_;
+   std::array<std::vector<uint64_t>, num_players> goal_full_;
+   // Start of each node's edges in edges_, with the total at the end.
+   std::vector<uint32_t> edge_offsets_;
 };
 
 int count_set_bits(uint32_t src) noexcept;
 
+// Number of combinations C(n, k). Only valid for n <= 16.
+int binomial(int n, int k) noexcept;
+
 inline int ColorNode::parity() const noexcept
 {
    return (player[0].distance + player[1].distance) % num_players;
 }
 
+inline ColorEdges::Iterator::Iterator(const ColorNode* nodes,
+                                      const uint16_t* edge) noexcept
+: nodes_(nodes), edge_(edge)
+{ }
+
+inline const ColorNode* ColorEdges::Iterator::operator*() const noexcept
+{
+   return nodes_ + *edge_;
+}
+
+inline ColorEdges::Iterator& ColorEdges::Iterator::operator++() noexcept
+{
+   ++edge_;
+   return *this;
+}
+
+inline bool ColorEdges::Iterator::operator!=(const Iterator& rhs) const noexcept
+{
+   return edge_ != rhs.edge_;
+}
+
+inline ColorEdges::ColorEdges(const ColorNode* nodes,
+                              const uint16_t* first,
+                              int size) noexcept
+: nodes_(nodes), first_(first), size_(size)
+{ }
+
+inline ColorEdges::Iterator ColorEdges::begin() const noexcept
+{
+   return { nodes_, first_ };
+}
+
+inline ColorEdges::Iterator ColorEdges::end() const noexcept
+{
+   return { nodes_, first_ + size_ };
+}
+
+inline bool ColorEdges::empty() const noexcept
+{
+   return size_ == 0;
+}
+
+inline int ColorEdges::size() const noexcept
+{
+   return size_;
+}
+
+inline const ColorNode* ColorEdges::operator[](int index) const noexcept
+{
+   assert(index >= 0);
+   assert(index < size_);
+   return nodes_ + first_[index];
+}
+
+inline ColorEdges ColorNode::moves(int idx) const noexcept
+{
+   // Since a node's index is its position in the node array, we can find the
+   // start of the array without a pointer back to the graph.
+   auto offset = idx ? player[0].num_moves : 0;
+   return { this - index, edges + offset, player[idx].num_moves };
+}
+
+inline ColorEdges ColorNode::unmoves(int idx) const noexcept
+{
+   auto offset = player[0].num_moves + player[1].num_moves +
+                 (idx ? player[0].num_unmoves : 0);
+   return { this - index, edges + offset, player[idx].num_unmoves };
+}
+
 inline const ColorNode* ColorGraph::start() const noexcept
 {
    return operator[](start_index_);
@@ -148,6 +323,39 @@ inline const ColorNode* ColorGraph::operator[](int index) const noexcept
    return &nodes_[index];
 }
 
+inline bool ColorGraph::renumbered() const noexcept
+{
+   return !order_.empty();
+}
+
+inline int ColorGraph::original_index(int index) const noexcept
+{
+   return order_.empty() ? index : order_[index];
+}
+
+inline const std::vector<short>& ColorGraph::distances(int idx) const noexcept
+{
+   return distances_[idx];
+}
+
+inline const std::vector<uint8_t>&
+ColorGraph::num_moves(int idx) const noexcept
+{
+   return num_moves_[idx];
+}
+
+inline const std::vector<uint64_t>&
+ColorGraph::goal_reached(int idx) const noexcept
+{
+   return goal_reached_[idx];
+}
+
+inline const std::vector<uint64_t>&
+ColorGraph::goal_full(int idx) const noexcept
+{
+   return goal_full_[idx];
+}
+
 inline bool is_valid_player(int player) noexcept
 {
    return (player >= 0) && (player < num_players);
@@ -6,14 +6,105 @@
 //
 
 #include "Graph.h"
+#include "ThreadPool.h"
+#include <algorithm>
 
 Graph::Graph(int width, int height, BitBoard start0)
-: board_(width, height),
+: Graph({ width, height }, start0, std::async(std::launch::async, [=] {
+     Board board(width, height);
+     return ColorGraph(board, WHITE, get_start_positions(board, start0, WHITE));
+  }))
+{ }
+
+Graph::Graph(const Board& board, BitBoard start0, std::future<ColorGraph> white)
+: board_(board),
   num_pieces_(count_set_bits(start0)),
   black_(board_, BLACK, get_start_positions(board_, start0, BLACK)),
-  white_(board_, WHITE, get_start_positions(board_, start0, WHITE))
+  white_(white.get())
+{
+   init_players();
+   init_terminals();
+}
+
+Graph::Graph(int width, int height) noexcept
+: board_(width, height),
+  num_pieces_(0)
 { }
 
+NodeSet Graph::reachable() const
+{
+   NodeSet result(size());
+   std::vector<int> frontier = { index(start()) };
+   result.insert(frontier.front());
+
+   // Breadth-first search, one level at a time. The threads expand chunks of
+   // the frontier, and the set decides which thread gets each new node. The
+   // same pool runs every level, since a search can have hundreds of them.
+   constexpr int chunk_size = 1024;
+   ThreadPool pool;
+   std::vector<std::vector<int>> next(pool.size());
+   while (!frontier.empty()) {
+      for (auto& nodes : next) {
+         nodes.clear();
+      }
+      pool.run(0,
+               static_cast<int>(frontier.size()),
+               chunk_size,
+               [&](int first, int last, int thread) {
+         for (auto i = first; i < last; ++i) {
+            auto id = NodeId(frontier[i]);
+            if (is_terminal(id)) {
+               continue;
+            }
+            for_each_move(id, [&](NodeId move) {
+               if (result.try_insert(move.index())) {
+                  next[thread].push_back(move.index());
+               }
+            });
+         }
+      });
+
+      frontier.clear();
+      for (auto& nodes : next) {
+         frontier.insert(frontier.end(), nodes.begin(), nodes.end());
+      }
+   }
+
+   result.build_index();
+   return result;
+}
+
+void Graph::renumber()
+{
+   black_.renumber();
+   white_.renumber();
+   init_players();
+   init_terminals();
+}
+
+std::unique_ptr<Graph> Graph::load(std::istream& istrm,
+                                   int width,
+                                   int height,
+                                   bool renumbered)
+{
+   std::unique_ptr<Graph> graph(new Graph(width, height));
+   if (!graph->black_.load(istrm, renumbered) ||
+       !graph->white_.load(istrm, renumbered)) {
+      return nullptr;
+   }
+   auto start = graph->start().position(graph->board_);
+   graph->num_pieces_ = count_set_bits(start[0]);
+   graph->init_players();
+   graph->init_terminals();
+   return graph;
+}
+
+void Graph::save(std::ostream& ostrm) const
+{
+   black_.save(ostrm);
+   white_.save(ostrm);
+}
+
 Node Graph::start() const noexcept
 {
    // Player 0 always goes first.
@@ -53,15 +144,98 @@ Node Graph::operator[](int index) const noexcept
    assert(index >= 0);
    assert(index < size());
 
-   auto black = black_[index / white_.size()];
-   auto white = white_[index % white_.size()];
-   return Node(player(black, white), black, white);
+   return node_at(index / white_.size(), index % white_.size());
+}
+
+int Graph::num_tiles(int rows, int cols) const noexcept
+{
+   auto tile_rows = (black_.size() + rows - 1) / rows;
+   auto tile_cols = (white_.size() + cols - 1) / cols;
+   return tile_rows * tile_cols;
+}
+
+Graph::Tile Graph::tile(int index, int rows, int cols) const noexcept
+{
+   assert(index < num_tiles(rows, cols));
+   auto tile_cols = (white_.size() + cols - 1) / cols;
+   auto black_begin = (index / tile_cols) * rows;
+   auto white_begin = (index % tile_cols) * cols;
+   return {
+      black_begin,
+      std::min(black_begin + rows, black_.size()),
+      white_begin,
+      std::min(white_begin + cols, white_.size())
+   };
 }
 
 int Graph::player(const ColorNode* black, const ColorNode* white) const noexcept
 {
-   auto parity = (black->parity() + white->parity()) % num_players;
-   return (parity == start().parity()) ? 0 : 1;
+   return black_players_[black->index] ^ white_players_[white->index];
+}
+
+void Graph::init_players()
+{
+   // Player 0 moves whenever the parity matches the start position. The
+   // parity of a ColorNode is the parity of its total distance.
+   auto parities = [](const ColorGraph& graph) {
+      std::vector<uint8_t> result(graph.size());
+      auto& d0 = graph.distances(0);
+      auto& d1 = graph.distances(1);
+      for (auto i = 0; i < graph.size(); ++i) {
+         result[i] = (d0[i] + d1[i]) % num_players;
+      }
+      return result;
+   };
+   auto start_parity = start().parity();
+   black_players_ = parities(black_);
+   for (auto& player : black_players_) {
+      player ^= start_parity;
+   }
+   white_players_ = parities(white_);
+}
+
+void Graph::init_terminals()
+{
+   auto flags = [](const ColorGraph& graph) {
+      std::vector<uint8_t> result(graph.size());
+      for (auto i = 0; i < graph.size(); ++i) {
+         auto word = i / 64;
+         auto bit = uint64_t(1) << (i % 64);
+         for (auto j = 0; j < num_players; ++j) {
+            uint8_t player = 0;
+            if (graph.goal_full(j)[word] & bit) {
+               player |= GOAL_FULL;
+            }
+            if (graph.goal_reached(j)[word] & bit) {
+               player |= GOAL_REACHED;
+            }
+            if (graph.num_moves(j)[i] == 0) {
+               player |= NO_MOVES;
+            }
+            result[i] |= player << (j * terminal_shift);
+         }
+      }
+      return result;
+   };
+   black_terminals_ = flags(black_);
+   white_terminals_ = flags(white_);
+
+   auto num_words = (white_.size() + 63) / 64;
+   for (auto& no_moves : white_no_moves_) {
+      no_moves.assign(num_words, 0);
+   }
+   white_player1_.assign(num_words, 0);
+   for (auto i = 0; i < white_.size(); ++i) {
+      auto bit = uint64_t(1) << (i % 64);
+      for (auto j = 0; j < num_players; ++j) {
+         if (white_.num_moves(j)[i] == 0) {
+            white_no_moves_[j][i / 64] |= bit;
+         }
+      }
+      if (white_players_[i]) {
+         white_player1_[i / 64] |= bit;
+      }
+   }
 }
 
 ColorPosition Graph::get_start_positions(const Board& board,
@@ -10,6 +10,24 @@
 
 #include "ColorGraph.h"
 #include "Node.h"
+#include "NodeSet.h"
+#include <future>
+#include <memory>
+
+// Compact handle for a node in a Graph: just the node's index, so it's a
+// sixth the size of a Node. The Graph expands it into a Node when the
+// details are needed.
+class NodeId
+{
+public:
+   NodeId() = default;
+   explicit NodeId(int index) noexcept;
+   int index() const noexcept;
+   bool operator==(const NodeId& rhs) const noexcept = default;
+
+private:
+   uint32_t index_ = 0;
+};
 
 // Represents the game graph.
 class Graph
@@ -30,10 +48,91 @@ public:
    int index(const Node& node) const noexcept;
    // Returns the node at the given index.
    Node operator[](int index) const noexcept;
+   // Returns the node with the given black and white indices. Faster than
+   // operator[], since there's no division.
+   Node node_at(int b_idx, int w_idx) const noexcept;
+
+   // Compact handle for the node.
+   NodeId id(const Node& node) const noexcept;
+   // Returns the node for the handle.
+   Node operator[](NodeId id) const noexcept;
+   // Black and white indices of the node.
+   std::pair<int, int> indices(NodeId id) const noexcept;
+   // Player with the next move, without building the Node.
+   int player(NodeId id) const noexcept;
+   int player(int b_idx, int w_idx) const noexcept;
+   // Invokes func(move) with the handle of each node in Node::moves(), in
+   // the same order, without building any Nodes.
+   template<class Func>
+   void for_each_move(NodeId id, Func func) const;
+
+   // Winner of a terminal node, or -1 if the node isn't terminal. Same as
+   // Node::is_winner and Node::no_moves, but reads a byte per color instead
+   // of the ColorNodes.
+   int terminal_winner(NodeId id) const noexcept;
+   bool is_terminal(NodeId id) const noexcept;
+   // Terminal nodes among white nodes [64 * word, 64 * word + 64) of the
+   // black row, one mask per winner. Bits past the end of the row are
+   // undefined.
+   std::array<uint64_t, num_players> terminal_wins(int b_idx,
+                                                   int word) const noexcept;
+
+   // Rectangular block of nodes: black indices [black_begin, black_end) by
+   // white indices [white_begin, white_end). Walking the graph by tiles keeps
+   // the entries of successors in cache, since black moves stay in the same
+   // columns and white moves stay in the same rows.
+   struct Tile
+   {
+      int black_begin;
+      int black_end;
+      int white_begin;
+      int white_end;
+   };
+   // Number of tiles of at most rows black nodes by cols white nodes needed
+   // to cover the graph.
+   int num_tiles(int rows, int cols) const noexcept;
+   // Returns one of those tiles. Tiles are numbered row of tiles by row of
+   // tiles.
+   Tile tile(int index, int rows, int cols) const noexcept;
+   // The graphs for each color. A node's index is its black index times the
+   // size of the white graph plus its white index, and every move changes
+   // only one of the two.
+   const ColorGraph& black() const noexcept;
+   const ColorGraph& white() const noexcept;
+
+   // Returns the nodes that can be reached from the start position. Play
+   // stops at terminal nodes, so their successors aren't followed.
+   NodeSet reachable() const;
+
+   // Renumbers both ColorGraphs, so the successors of a node tend to share
+   // its cache lines. Invalidates every index, NodeId, and Node.
+   void renumber();
+   // Returns true if the graph has been renumbered.
+   bool renumbered() const noexcept;
+   // Index the node had when the graph was built, before any renumbering.
+   int original_index(int index) const noexcept;
+
+   // Loads a graph previously written by save. Returns nullptr if the stream
+   // doesn't contain a valid graph. renumbered must match the saved graph.
+   static std::unique_ptr<Graph> load(std::istream& istrm,
+                                      int width,
+                                      int height,
+                                      bool renumbered = false);
+   void save(std::ostream& ostrm) const;
 
 private:
+   // Constructs a graph with empty ColorGraphs, so they can be loaded.
+   Graph(int width, int height) noexcept;
+   // Builds the black graph on the calling thread while the white graph is
+   // being built asynchronously.
+   Graph(const Board& board, BitBoard start0, std::future<ColorGraph> white);
    // Deduces the next player based on the ColorNodes.
    int player(const ColorNode* black, const ColorNode* white) const noexcept;
+   // Precomputes the contribution of each ColorNode to the next player.
+   void init_players();
+   // Precomputes the terminal conditions of each ColorNode. Must follow
+   // init_players.
+   void init_terminals();
    // Helper function to compute the per-color start positions.
    static ColorPosition get_start_positions(const Board& board,
                                             BitBoard start0,
@@ -42,6 +141,21 @@ private:
    int num_pieces_;
    ColorGraph black_;
    ColorGraph white_;
+   // The next player is the xor of these.
+   std::vector<uint8_t> black_players_;
+   std::vector<uint8_t> white_players_;
+   // Terminal conditions of each ColorNode. Player 1's flags are shifted
+   // left by terminal_shift. A node is won by a player if both ColorNodes
+   // have the player's goal full and either has it reached, and it's lost by
+   // the player to move if neither ColorNode has any moves for him.
+   enum { GOAL_FULL = 1, GOAL_REACHED = 2, NO_MOVES = 4 };
+   static constexpr int terminal_shift = 3;
+   std::vector<uint8_t> black_terminals_;
+   std::vector<uint8_t> white_terminals_;
+   // The same for the white nodes, but as bitsets, so a word of a row can be
+   // checked at once.
+   std::array<std::vector<uint64_t>, num_players> white_no_moves_;
+   std::vector<uint64_t> white_player1_;
 };
 
 inline const Board& Graph::board() const noexcept
@@ -49,4 +163,138 @@ inline const Board& Graph::board() const noexcept
    return board_;
 }
 
+inline Node Graph::node_at(int b_idx, int w_idx) const noexcept
+{
+   return Node(black_players_[b_idx] ^ white_players_[w_idx],
+               black_[b_idx],
+               white_[w_idx]);
+}
+
+inline NodeId Graph::id(const Node& node) const noexcept
+{
+   return NodeId(index(node));
+}
+
+inline Node Graph::operator[](NodeId id) const noexcept
+{
+   return (*this)[id.index()];
+}
+
+inline std::pair<int, int> Graph::indices(NodeId id) const noexcept
+{
+   return { id.index() / white_.size(), id.index() % white_.size() };
+}
+
+inline int Graph::player(NodeId id) const noexcept
+{
+   auto [b_idx, w_idx] = indices(id);
+   return player(b_idx, w_idx);
+}
+
+inline int Graph::player(int b_idx, int w_idx) const noexcept
+{
+   return black_players_[b_idx] ^ white_players_[w_idx];
+}
+
+template<class Func>
+void Graph::for_each_move(NodeId id, Func func) const
+{
+   auto [b_idx, w_idx] = indices(id);
+   auto player = this->player(b_idx, w_idx);
+   auto num_white = white_.size();
+
+   // Black moves stay in the same column; white moves in the same row.
+   for (auto move : black_[b_idx]->moves(player)) {
+      func(NodeId(move->index * num_white + w_idx));
+   }
+   for (auto move : white_[w_idx]->moves(player)) {
+      func(NodeId(b_idx * num_white + move->index));
+   }
+}
+
+inline int Graph::terminal_winner(NodeId id) const noexcept
+{
+   auto [b_idx, w_idx] = indices(id);
+   auto both = black_terminals_[b_idx] & white_terminals_[w_idx];
+   auto either = black_terminals_[b_idx] | white_terminals_[w_idx];
+   for (auto i = 0; i < num_players; ++i) {
+      auto shift = i * terminal_shift;
+      if (((both >> shift) & GOAL_FULL) && ((either >> shift) & GOAL_REACHED)) {
+         return i;
+      }
+   }
+   auto player = this->player(b_idx, w_idx);
+   if ((both >> (player * terminal_shift)) & NO_MOVES) {
+      return other_player(player);
+   }
+   return -1;
+}
+
+inline bool Graph::is_terminal(NodeId id) const noexcept
+{
+   return terminal_winner(id) >= 0;
+}
+
+inline std::array<uint64_t, num_players>
+Graph::terminal_wins(int b_idx, int word) const noexcept
+{
+   auto black = black_terminals_[b_idx];
+   std::array<uint64_t, num_players> wins;
+   uint64_t no_moves[num_players];
+   for (auto i = 0; i < num_players; ++i) {
+      auto flags = black >> (i * terminal_shift);
+      auto full = (flags & GOAL_FULL) ? white_.goal_full(i)[word] : 0;
+      auto reached = (flags & GOAL_REACHED) ? ~uint64_t(0)
+                                            : white_.goal_reached(i)[word];
+      wins[i] = full & reached;
+      no_moves[i] = (flags & NO_MOVES) ? white_no_moves_[i][word] : 0;
+   }
+   // Player 0 takes precedence, as in terminal_winner.
+   wins[1] &= ~wins[0];
+
+   // A player with no moves loses, but only if it's his turn.
+   auto player1 = white_player1_[word];
+   if (black_players_[b_idx]) {
+      player1 = ~player1;
+   }
+   auto stuck = ((no_moves[0] & ~player1) | (no_moves[1] & player1)) &
+                ~(wins[0] | wins[1]);
+   wins[0] |= stuck & player1;
+   wins[1] |= stuck & ~player1;
+   return wins;
+}
+
+inline bool Graph::renumbered() const noexcept
+{
+   return black_.renumbered();
+}
+
+inline int Graph::original_index(int index) const noexcept
+{
+   auto [b_idx, w_idx] = indices(NodeId(index));
+   return black_.original_index(b_idx) * white_.size() +
+          white_.original_index(w_idx);
+}
+
+inline const ColorGraph& Graph::black() const noexcept
+{
+   return black_;
+}
+
+inline const ColorGraph& Graph::white() const noexcept
+{
+   return white_;
+}
+
+inline NodeId::NodeId(int index) noexcept
+: index_(index)
+{
+   assert(index >= 0);
+}
+
+inline int NodeId::index() const noexcept
+{
+   return index_;
+}
+
 #endif /* Graph_h */
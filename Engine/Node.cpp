@@ -35,7 +35,7 @@ bool Node::is_terminal() const noexcept
 
 bool Node::no_moves() const noexcept
 {
-   return black().moves.empty() && white().moves.empty();
+   return (black().num_moves == 0) && (white().num_moves == 0);
 }
 
 bool Node::is_winner(int idx) const noexcept
@@ -48,16 +48,36 @@ bool Node::is_winner(int idx) const noexcept
 
 std::vector<Node> Node::moves() const
 {
+   std::vector<Node> result;
+   result.reserve(num_moves());
+   for_each_move([&result](const Node& move) {
+      result.push_back(move);
+   });
+   return result;
+}
+
+int Node::num_moves() const noexcept
+{
+   return black().num_moves + white().num_moves;
+}
+
+Node Node::move(int k) const noexcept
+{
+   assert(k < num_moves());
    auto next = other_player(player());
+   auto black_moves = black_->moves(player());
+   if (k < black_moves.size()) {
+      return Node(next, black_moves[k], white_);
+   }
+   return Node(next, black_, white_->moves(player())[k - black_moves.size()]);
+}
 
-   // Player can move a black piece or a white piece.
+std::vector<Node> Node::unmoves() const
+{
    std::vector<Node> result;
-   for (auto move : black().moves) {
-      result.push_back(Node(next, move, white_));
-   }
-   for (auto move : white().moves) {
-      result.push_back(Node(next, black_, move));
-   }
+   for_each_unmove([&result](const Node& unmove) {
+      result.push_back(unmove);
+   });
    return result;
 }
 
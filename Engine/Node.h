@@ -35,6 +35,22 @@ public:
    bool is_winner(int idx) const noexcept;
    // Available moves for the current player.
    std::vector<Node> moves() const;
+   // Number of moves available to the current player. This is much faster
+   // than moves().size().
+   int num_moves() const noexcept;
+   // Returns moves()[k] without building the whole list.
+   Node move(int k) const noexcept;
+   // Calls func(move) for each node in moves(), in the same order, without
+   // building the list.
+   template<typename Func>
+   void for_each_move(Func func) const;
+   // Nodes from which the other player could have moved to this node. This is
+   // the inverse of moves().
+   std::vector<Node> unmoves() const;
+   // Calls func(unmove) for each node in unmoves(), in the same order,
+   // without building the list.
+   template<typename Func>
+   void for_each_unmove(Func func) const;
    // Number of moves it would take the current player to put all his pieces
    // on the goal if the other player doesn't interfere.
    int distance() const noexcept;
@@ -73,4 +89,32 @@ inline int Node::parity() const noexcept
    return (black_->parity() + white_->parity()) % num_players;
 }
 
+template<typename Func>
+inline void Node::for_each_move(Func func) const
+{
+   auto next = other_player(player());
+
+   // Player can move a black piece or a white piece.
+   for (auto move : black_->moves(player())) {
+      func(Node(next, move, white_));
+   }
+   for (auto move : white_->moves(player())) {
+      func(Node(next, black_, move));
+   }
+}
+
+template<typename Func>
+inline void Node::for_each_unmove(Func func) const
+{
+   auto prev = other_player(player());
+
+   // The previous player moved either a black piece or a white piece.
+   for (auto unmove : black_->unmoves(prev)) {
+      func(Node(prev, unmove, white_));
+   }
+   for (auto unmove : white_->unmoves(prev)) {
+      func(Node(prev, black_, unmove));
+   }
+}
+
 #endif /* Node_h */
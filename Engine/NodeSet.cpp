@@ -0,0 +1,40 @@
+//
+// Copyright 2023 Stephen E. Bensley
+//
+// This file is licensed under the MIT License. You may obtain a copy of the
+// license at https://github.com/stephenbensley/FiveFieldKono/blob/main/LICENSE.
+//
+
+#include "NodeSet.h"
+#include <algorithm>
+
+NodeSet::NodeSet(int size)
+: size_(size),
+  words_((size + 63) / 64)
+{ }
+
+void NodeSet::build_index()
+{
+   ranks_.resize(words_.size() + 1);
+   auto total = 0;
+   for (auto i = 0; i < num_words(); ++i) {
+      ranks_[i] = total;
+      total += std::popcount(words_[i]);
+   }
+   ranks_.back() = total;
+}
+
+int NodeSet::select(int rank) const noexcept
+{
+   assert(rank < count());
+
+   // Find the last word that starts at or before the rank ...
+   auto it = std::upper_bound(ranks_.begin(), ranks_.end(), rank);
+   auto word_index = static_cast<int>(it - ranks_.begin()) - 1;
+   // ... and then the bit within the word.
+   auto word = words_[word_index];
+   for (auto i = ranks_[word_index]; i < rank; ++i) {
+      word &= word - 1;
+   }
+   return word_index * 64 + std::countr_zero(word);
+}
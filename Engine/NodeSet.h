@@ -0,0 +1,110 @@
+//
+// Copyright 2023 Stephen E. Bensley
+//
+// This file is licensed under the MIT License. You may obtain a copy of the
+// license at https://github.com/stephenbensley/FiveFieldKono/blob/main/LICENSE.
+//
+
+#ifndef NodeSet_h
+#define NodeSet_h
+
+#include <atomic>
+#include <bit>
+#include <cassert>
+#include <cstdint>
+#include <vector>
+
+// Set of node indices stored as a bitset. Once the set is complete, build
+// the rank index, so that members can be numbered densely: rank maps a
+// member to its position among the members, and select maps it back.
+class NodeSet
+{
+public:
+   NodeSet() = default;
+   // Creates an empty set that can hold indices in [0, size).
+   explicit NodeSet(int size);
+
+   // Number of indices the set can hold.
+   int size() const noexcept;
+   bool contains(int index) const noexcept;
+   void insert(int index) noexcept;
+   // Inserts the index atomically, so threads can insert concurrently.
+   // Returns true if the index wasn't already a member.
+   bool try_insert(int index) noexcept;
+
+   // Must be called after the last insertion and before rank, select, or
+   // count.
+   void build_index();
+   // Number of members.
+   int count() const noexcept;
+   // Number of members less than index.
+   int rank(int index) const noexcept;
+   // Returns the member with the given rank.
+   int select(int rank) const noexcept;
+
+   // Raw bits for serialization.
+   int num_words() const noexcept;
+   const uint64_t* words() const noexcept;
+   uint64_t* words() noexcept;
+
+private:
+   int size_ = 0;
+   std::vector<uint64_t> words_;
+   // Number of members before each word, plus the total at the end.
+   std::vector<int> ranks_;
+};
+
+inline int NodeSet::size() const noexcept
+{
+   return size_;
+}
+
+inline bool NodeSet::contains(int index) const noexcept
+{
+   assert(index < size_);
+   return (words_[index / 64] >> (index % 64)) & 1;
+}
+
+inline void NodeSet::insert(int index) noexcept
+{
+   assert(index < size_);
+   words_[index / 64] |= uint64_t(1) << (index % 64);
+}
+
+inline bool NodeSet::try_insert(int index) noexcept
+{
+   assert(index < size_);
+   auto mask = uint64_t(1) << (index % 64);
+   std::atomic_ref<uint64_t> word(words_[index / 64]);
+   return (word.fetch_or(mask, std::memory_order_relaxed) & mask) == 0;
+}
+
+inline int NodeSet::count() const noexcept
+{
+   assert(!ranks_.empty());
+   return ranks_.back();
+}
+
+inline int NodeSet::rank(int index) const noexcept
+{
+   assert(!ranks_.empty());
+   auto mask = (uint64_t(1) << (index % 64)) - 1;
+   return ranks_[index / 64] + std::popcount(words_[index / 64] & mask);
+}
+
+inline int NodeSet::num_words() const noexcept
+{
+   return static_cast<int>(words_.size());
+}
+
+inline const uint64_t* NodeSet::words() const noexcept
+{
+   return words_.data();
+}
+
+inline uint64_t* NodeSet::words() noexcept
+{
+   return words_.data();
+}
+
+#endif /* NodeSet_h */
@@ -0,0 +1,50 @@
+//
+// Copyright 2023 Stephen E. Bensley
+//
+// This file is licensed under the MIT License. You may obtain a copy of the
+// license at https://github.com/stephenbensley/FiveFieldKono/blob/main/LICENSE.
+//
+
+#ifndef Parallel_h
+#define Parallel_h
+
+#include <algorithm>
+#include <future>
+#include <thread>
+#include <vector>
+
+// Number of threads to use for parallel loops.
+int num_hardware_threads() noexcept;
+
+// Invokes func(i) for every i in [begin, end). The range is split into one
+// contiguous block per thread, so the assignment of indices to threads is
+// deterministic.
+template<class Func>
+void parallel_for(int begin, int end, Func func)
+{
+   auto num_threads = num_hardware_threads();
+   auto block_size = (end - begin + num_threads - 1) / num_threads;
+
+   // Launch the workers ...
+   std::vector<std::future<void>> futures;
+   for (auto first = begin; first < end; first += block_size) {
+      auto last = std::min(first + block_size, end);
+      futures.push_back(std::async(std::launch::async, [first, last, &func] {
+         for (auto i = first; i < last; ++i) {
+            func(i);
+         }
+      }));
+   }
+   // ... and wait for them to complete.
+   for (auto& f : futures) {
+      f.get();
+   }
+}
+
+inline int num_hardware_threads() noexcept
+{
+   // hardware_concurrency is allowed to return zero if it can't tell.
+   return std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+}
+
+#endif /* Parallel_h */
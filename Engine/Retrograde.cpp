@@ -7,74 +7,130 @@
 
 #include "Retrograde.h"
 #include "ToString.h"
-#include <future>
+#include <algorithm>
+#include <bit>
+#include <chrono>
+#include <limits>
+#include <memory>
+#include <numeric>
 
-Retrograde::Retrograde(const Graph& graph)
-: num_workers_(std::thread::hardware_concurrency()),
+Retrograde::Retrograde(const Graph& graph,
+                       int num_threads,
+                       bool reachable_only)
+: pool_(num_threads),
+  counts_(pool_.size()),
+  batches_(pool_.size()),
+  unsolved_(graph.black().size(), graph.white().size()),
   num_nodes_(graph.size()),
   graph_(graph),
-  strategy_(graph)
-{ }
+  strategy_(reachable_only ? Strategy(graph, graph.reachable())
+                           : Strategy(graph))
+{
+   for (auto& batch : batches_) {
+      batch.nodes.reserve(Batch::capacity);
+   }
+}
 
-int Retrograde::analyze()
+int Retrograde::analyze(Algorithm algorithm)
 {
-   for (auto depth = 0; depth < strategy_.max_depth(); ++depth) {
-      auto count = analyze_nodes(depth);
-      // If no nodes were updated, we can't make any more progress.
-      if (count == 0) {
+   switch (algorithm) {
+      case SWEEP:
+         analyze_sweep(false);
+         break;
+      case LOCKSTEP:
+         analyze_sweep(true);
+         break;
+      case BITWISE:
+         analyze_bitwise();
+         break;
+      case SCC:
+         analyze_scc();
+         break;
+      case QUEUE:
+         analyze_queue();
          break;
-      }
    }
 
-   return strategy_.find(graph_.start()).value();
+   return strategy_.entry(graph_.index(graph_.start())).value();
 }
 
-bool Retrograde::analyze_node_zero(const Node& node) noexcept
+void Retrograde::add_best_moves()
 {
-   // Retrieve the entry for this node.
-   auto& entry = strategy_.find(node);
+   strategy_.add_best_moves();
+   pool_.run(0, num_nodes_, chunk_size, [this](int first, int last, int) {
+      for (auto index = first; index < last; ++index) {
+         if (!strategy_.contains(index)) {
+            continue;
+         }
+         if (!graph_.is_terminal(NodeId(index))) {
+            strategy_.set_best_move(index,
+                                    strategy_.find_best_move(graph_[index]));
+         }
+      }
+   });
+}
 
-   if (node.is_winner(0)) {
-      entry = { 0, 0 };
-   } else if (node.is_winner(1)) {
-      entry = { 1, 0 };;
-   } else if (node.no_moves()) {
-      entry = { other_player(node.player()), 0 };
-   } else {
-      // Not a terminal node, so ignore on pass zero.
-      return false;
+uint64_t Retrograde::stored(int b_idx, int word, uint64_t mask) const noexcept
+{
+   if (!strategy_.compact()) {
+      return mask;
    }
+   auto base = b_idx * graph_.white().size() + word * 64;
+   for (auto bits = mask; bits != 0; bits &= bits - 1) {
+      auto bit = std::countr_zero(bits);
+      if (!strategy_.contains(base + bit)) {
+         mask &= ~(uint64_t(1) << bit);
+      }
+   }
+   return mask;
+}
 
-   return true;
+uint64_t Retrograde::analyze_terminals(int b_idx,
+                                       int word,
+                                       uint64_t mask) noexcept
+{
+   auto wins = graph_.terminal_wins(b_idx, word);
+   auto base = b_idx * graph_.white().size() + word * 64;
+   uint64_t solved = 0;
+   for (auto winner = 0; winner < num_players; ++winner) {
+      auto bits = wins[winner] & mask;
+      solved |= bits;
+      for (; bits != 0; bits &= bits - 1) {
+         strategy_.set_entry(base + std::countr_zero(bits), { winner, 0 });
+      }
+   }
+   return solved;
 }
 
-bool Retrograde::analyze_node(const Node& node, int depth) noexcept
+bool Retrograde::analyze_node(NodeId id,
+                              int player,
+                              const int* successors,
+                              int num_successors,
+                              int depth,
+                              bool lockstep) noexcept
 {
-   // Retrieve the entry for this node.
-   auto& entry = strategy_.find(node);
+   auto index = id.index();
 
-   // If the entry has already been assigned a value, there's nothing to do.
-   if (!entry.empty()) {
-      return false;
-   }
+   // Solved nodes are filtered out by the unsolved bitmap.
+   assert(strategy_.entry(index).empty());
 
    // Number of moves that lead to a guaranteed loss.
    auto loss_count = 0;
 
-   auto moves = node.moves();
-   assert(moves.size() != 0);
-   for (auto move : moves) {
-      Strategy::Entry move_entry = strategy_.find(move);
+   assert(num_successors != 0);
+   for (auto i = 0; i < num_successors; ++i) {
+      auto move_entry = strategy_.entry(successors[i]);
 
-      // Ignore empty entries.
-      if (move_entry.empty()) {
+      // Ignore empty entries. In lockstep, also ignore entries solved during
+      // this pass, since whether we see them depends on timing.
+      if (move_entry.empty() || (lockstep && (move_entry.depth() == depth))) {
          continue;
       }
 
       // If we find even one winner, the player can always make that move, so
       // this node is also a guaranteed winner.
-      if (move_entry.winner() == node.player()) {
-         entry = { node.player(), depth };
+      if (move_entry.winner() == player) {
+         strategy_.set_entry(index, { player, depth });
          return true;
       }
 
@@ -83,42 +139,808 @@ bool Retrograde::analyze_node(const Node& node, int depth) noexcept
 
    // If every node leads to a guaranteed loss, then there's nothing the
    // current player can do to avoid it, so this node is a guaranteed loss, too.
-   if (loss_count == moves.size()) {
-      entry = { other_player(node.player()), depth };
+   if (loss_count == num_successors) {
+      strategy_.set_entry(index, { other_player(player), depth });
       return true;
    }
 
    return false;
 }
 
-int Retrograde::analyze_nodes_worker(int index, int depth) noexcept
+void Retrograde::add_to_batch(Batch& batch, int b_idx, int w_idx) const
+{
+   auto num_white = graph_.white().size();
+   auto player = graph_.player(b_idx, w_idx);
+   auto first = static_cast<int>(batch.successors.size());
+
+   // Same successors as Node::moves(), but without building the Nodes or
+   // dividing to find the indices.
+   for (auto move : graph_.black()[b_idx]->moves(player)) {
+      batch.successors.push_back(move->index * num_white + w_idx);
+   }
+   for (auto move : graph_.white()[w_idx]->moves(player)) {
+      batch.successors.push_back(b_idx * num_white + move->index);
+   }
+   auto last = static_cast<int>(batch.successors.size());
+   for (auto i = first; i < last; ++i) {
+      strategy_.prefetch(batch.successors[i]);
+   }
+
+   batch.nodes.push_back({
+      NodeId(b_idx * num_white + w_idx),
+      player,
+      first,
+      last
+   });
+}
+
+template<class Func>
+int Retrograde::analyze_batch(Batch& batch,
+                              int depth,
+                              bool lockstep,
+                              Func func)
 {
    auto count = 0;
-   for (auto i = index; i < num_nodes_; i += num_workers_) {
-      auto node = graph_[i];
-      if ((depth == 0) ? analyze_node_zero(node) : analyze_node(node, depth)) {
+   for (auto& pending : batch.nodes) {
+      auto solved = analyze_node(pending.id,
+                                 pending.player,
+                                 batch.successors.data() + pending.first,
+                                 pending.last - pending.first,
+                                 depth,
+                                 lockstep);
+      if (solved) {
          ++count;
       }
+      func(pending, solved);
    }
+   batch.nodes.clear();
+   batch.successors.clear();
    return count;
 }
 
-int Retrograde::analyze_nodes(int depth)
+int Retrograde::analyze_tile_worker(const Graph::Tile& tile,
+                                    int depth,
+                                    bool lockstep,
+                                    Batch& batch)
 {
-   // Launch the workers ...
-   std::vector<std::future<int>> futures;
-   for (auto i = 0; i < num_workers_; ++i) {
-      futures.push_back(std::async(std::launch::async,
-                                   &Retrograde::analyze_nodes_worker,
-                                   this,
-                                   i,
-                                   depth));
+   static_assert(tile_cols % 64 == 0);
+   assert(tile.white_begin % 64 == 0);
+
+   // Clears the node's bit once it's solved.
+   auto update = [this](const Batch::Pending& pending, bool solved) {
+      if (solved) {
+         auto [b_idx, w_idx] = graph_.indices(pending.id);
+         unsolved_.row(b_idx)[w_idx / 64] &= ~(uint64_t(1) << (w_idx % 64));
+      }
+   };
+
+   auto count = 0;
+   for (auto b_idx = tile.black_begin; b_idx < tile.black_end; ++b_idx) {
+      auto row = unsolved_.row(b_idx);
+      for (auto w_idx = tile.white_begin; w_idx < tile.white_end; w_idx += 64) {
+         // Pass zero visits everything to find the terminal nodes.
+         auto bits = (depth == 0) ? ~uint64_t(0) : row[w_idx / 64];
+         if (tile.white_end - w_idx < 64) {
+            bits &= (uint64_t(1) << (tile.white_end - w_idx)) - 1;
+         }
+         if (depth == 0) {
+            // Terminal nodes don't depend on their successors, so a whole
+            // word is solved at once. Nodes that aren't stored are never
+            // solved.
+            bits = stored(b_idx, w_idx / 64, bits);
+            auto solved = analyze_terminals(b_idx, w_idx / 64, bits);
+            row[w_idx / 64] = bits & ~solved;
+            count += std::popcount(solved);
+            continue;
+         }
+         while (bits != 0) {
+            auto bit = std::countr_zero(bits);
+            bits &= bits - 1;
+            add_to_batch(batch, b_idx, w_idx + bit);
+            if (batch.nodes.size() == Batch::capacity) {
+               count += analyze_batch(batch, depth, lockstep, update);
+            }
+         }
+      }
    }
-   // ... and wait for them to complete.
+   count += analyze_batch(batch, depth, lockstep, update);
+   return count;
+}
+
+int Retrograde::analyze_worklist_worker(int first,
+                                        int last,
+                                        int depth,
+                                        bool lockstep,
+                                        Batch& batch)
+{
+   // Compact the unsolved nodes to the start of the chunk. The chunks are
+   // gathered together after the pass. Nodes are read ahead of where they're
+   // written back, so batching doesn't clobber them.
+   auto kept = first;
+   auto update = [this, &kept](const Batch::Pending& pending, bool solved) {
+      if (!solved) {
+         worklist_[kept++] = pending.id;
+      }
+   };
+
    auto count = 0;
-   std::for_each(futures.begin(), futures.end(), [&count](auto& f){
-      count += f.get();
-   });
+   for (auto i = first; i < last; ++i) {
+      auto [b_idx, w_idx] = graph_.indices(worklist_[i]);
+      add_to_batch(batch, b_idx, w_idx);
+      if (batch.nodes.size() == Batch::capacity) {
+         count += analyze_batch(batch, depth, lockstep, update);
+      }
+   }
+   count += analyze_batch(batch, depth, lockstep, update);
+   worklist_kept_[first / chunk_size] = kept - first;
+   return count;
+}
+
+int Retrograde::analyze_nodes(int depth, bool lockstep)
+{
+   if (depth == 0) {
+      use_worklist_ = false;
+      num_unsolved_ = strategy_.num_entries();
+   }
+
+   std::fill(counts_.begin(), counts_.end(), Count{ 0 });
+   if (use_worklist_) {
+      pool_.run(0,
+                static_cast<int>(worklist_.size()),
+                chunk_size,
+                [=, this](int first, int last, int thread) {
+         counts_[thread].value += analyze_worklist_worker(first,
+                                                          last,
+                                                          depth,
+                                                          lockstep,
+                                                          batches_[thread]);
+      });
+   } else {
+      pool_.run_each(graph_.num_tiles(tile_rows, tile_cols),
+                     [=, this](int index, int thread) {
+         auto tile = graph_.tile(index, tile_rows, tile_cols);
+         counts_[thread].value += analyze_tile_worker(tile,
+                                                      depth,
+                                                      lockstep,
+                                                      batches_[thread]);
+      });
+   }
 
+   auto count = 0;
+   for (auto c : counts_) {
+      count += c.value;
+   }
+   update_worklist(count);
    return count;
 }
+
+void Retrograde::update_worklist(int num_solved)
+{
+   num_unsolved_ -= num_solved;
+
+   if (use_worklist_) {
+      // Each chunk has already been compacted in parallel, so all that's
+      // left is to slide the chunks down next to each other.
+      auto end = worklist_.begin();
+      auto num_chunks = static_cast<int>(worklist_kept_.size());
+      for (auto i = 0; i < num_chunks; ++i) {
+         auto first = worklist_.begin() + i * chunk_size;
+         end = std::copy(first, first + worklist_kept_[i], end);
+      }
+      worklist_.erase(end, worklist_.end());
+   } else if (num_unsolved_ <= num_nodes_ / 8) {
+      // Few enough nodes are left that the list is no bigger than a few bits
+      // per node, so switch over.
+      worklist_.clear();
+      auto num_white = graph_.white().size();
+      for (auto b_idx = 0; b_idx < unsolved_.rows(); ++b_idx) {
+         auto row = unsolved_.row(b_idx);
+         for (auto k = 0; k < unsolved_.words_per_row(); ++k) {
+            for (auto bits = row[k]; bits != 0; bits &= bits - 1) {
+               auto w_idx = k * 64 + std::countr_zero(bits);
+               worklist_.push_back(NodeId(b_idx * num_white + w_idx));
+            }
+         }
+      }
+      assert(static_cast<int>(worklist_.size()) == num_unsolved_);
+      use_worklist_ = true;
+   } else {
+      return;
+   }
+
+   worklist_kept_.resize((worklist_.size() + chunk_size - 1) / chunk_size);
+}
+
+void Retrograde::analyze_sweep(bool lockstep)
+{
+   for (auto depth = 0; fits(depth); ++depth) {
+      auto count = analyze_nodes(depth, lockstep);
+      // If no nodes were updated, we can't make any more progress.
+      if (count == 0) {
+         break;
+      }
+   }
+}
+
+void Retrograde::analyze_queue()
+{
+   // Number of moves from each node that haven't been proven to lose yet.
+   // Zero means the count hasn't been initialized, since a node whose count
+   // drops to zero is solved and never visited again.
+   std::vector<uint8_t> remaining(num_nodes_);
+
+   // Nodes solved at the previous depth ...
+   std::vector<int> frontier;
+   // ... and nodes solved at the current depth.
+   std::vector<int> next;
+
+   auto num_white = graph_.white().size();
+   for (auto b_idx = 0; b_idx < graph_.black().size(); ++b_idx) {
+      for (auto w_idx = 0; w_idx < num_white; w_idx += 64) {
+         auto mask = ~uint64_t(0);
+         if (num_white - w_idx < 64) {
+            mask = (uint64_t(1) << (num_white - w_idx)) - 1;
+         }
+         mask = stored(b_idx, w_idx / 64, mask);
+         auto solved = analyze_terminals(b_idx, w_idx / 64, mask);
+         for (; solved != 0; solved &= solved - 1) {
+            frontier.push_back(b_idx * num_white + w_idx +
+                               std::countr_zero(solved));
+         }
+      }
+   }
+
+   for (auto depth = 1;
+        !frontier.empty() && fits(depth);
+        ++depth) {
+      next.clear();
+      for (auto index : frontier) {
+         auto winner = strategy_.entry(index).winner();
+         graph_[index].for_each_unmove([&](const Node& unmove) {
+            auto unmove_index = graph_.index(unmove);
+            if (!strategy_.contains(unmove_index)) {
+               return;
+            }
+            if (!strategy_.entry(unmove_index).empty()) {
+               return;
+            }
+
+            // If the player can move to a winner, the node is a winner. If
+            // this was the last move that didn't lose, the node is a loser.
+            // Either way, the winner is the same as the winner of the move.
+            if (winner != unmove.player()) {
+               auto& count = remaining[unmove_index];
+               if (count == 0) {
+                  count = unmove.num_moves();
+               }
+               if (--count != 0) {
+                  return;
+               }
+            }
+
+            strategy_.set_entry(unmove_index, { winner, depth });
+            next.push_back(unmove_index);
+         });
+      }
+      std::swap(frontier, next);
+   }
+}
+
+void Retrograde::analyze_bitwise()
+{
+   // Pass zero finds the terminal nodes a word at a time.
+   if (analyze_nodes(0, true) == 0) {
+      return;
+   }
+
+   auto& black = graph_.black();
+   auto& white = graph_.white();
+   auto num_black = black.size();
+   auto num_white = white.size();
+
+   // The player to move is the parity of the black node combined with the
+   // parity of the white node. So which nodes in a row have player 1 to move
+   // is the same for every row, except that some rows are flipped. Likewise
+   // for columns.
+   auto player = [this, num_white](int b_idx, int w_idx) {
+      return graph_[b_idx * num_white + w_idx].player();
+   };
+   BitMatrix row_player1(1, num_white);
+   std::vector<bool> flip_row(num_black);
+   for (auto w_idx = 0; w_idx < num_white; ++w_idx) {
+      if (player(0, w_idx) == 1) {
+         row_player1.set(0, w_idx);
+      }
+   }
+   BitMatrix col_player1(1, num_black);
+   std::vector<bool> flip_col(num_white);
+   for (auto b_idx = 0; b_idx < num_black; ++b_idx) {
+      if (player(b_idx, 0) == 1) {
+         col_player1.set(0, b_idx);
+      }
+      flip_row[b_idx] = (player(b_idx, 0) != player(0, 0));
+   }
+   for (auto w_idx = 0; w_idx < num_white; ++w_idx) {
+      flip_col[w_idx] = (player(0, w_idx) != player(0, 0));
+   }
+
+   // Nodes won by each player, both by row and by column.
+   BitMatrix wins[num_players] = {
+      BitMatrix(num_black, num_white), BitMatrix(num_black, num_white)
+   };
+   BitMatrix wins_t[num_players] = {
+      BitMatrix(num_white, num_black), BitMatrix(num_white, num_black)
+   };
+   BitMatrix unsolved(num_black, num_white);
+   // Whether the player to move can reach a winning node and whether all of
+   // his moves reach losing nodes. These are first computed for white moves
+   // by column, and then transposed and updated for black moves by row.
+   BitMatrix any_t(num_white, num_black);
+   BitMatrix all_t(num_white, num_black);
+   BitMatrix any(num_black, num_white);
+   BitMatrix all(num_black, num_white);
+
+   pool_.run(0, num_black, 64, [&](int first, int last, int) {
+      for (auto b_idx = first; b_idx < last; ++b_idx) {
+         for (auto w_idx = 0; w_idx < num_white; ++w_idx) {
+            auto index = b_idx * num_white + w_idx;
+            if (!strategy_.contains(index)) {
+               continue;
+            }
+            auto entry = strategy_.entry(index);
+            if (entry.empty()) {
+               unsolved.set(b_idx, w_idx);
+            } else {
+               wins[entry.winner()].set(b_idx, w_idx);
+            }
+         }
+      }
+   });
+   transpose(wins_t[0], wins[0]);
+   transpose(wins_t[1], wins[1]);
+
+   // Folds the moves of one color into any and all. The matrices are either
+   // all by row (black moves) or all by column (white moves).
+   auto fold_moves = [](const ColorNode* node,
+                        const BitMatrix* wins,
+                        const uint64_t* player1,
+                        bool flip,
+                        uint64_t* any,
+                        uint64_t* all,
+                        int num_words) {
+      for (auto p = 0; p < num_players; ++p) {
+         for (auto move : node->moves(p)) {
+            auto won = wins[p].row(move->index);
+            auto lost = wins[other_player(p)].row(move->index);
+            for (auto k = 0; k < num_words; ++k) {
+               auto movers = (flip == (p == 1)) ? ~player1[k] : player1[k];
+               any[k] |= won[k] & movers;
+               all[k] &= lost[k] | ~movers;
+            }
+         }
+      }
+   };
+
+   for (auto depth = 1; fits(depth); ++depth) {
+      // White moves ...
+      pool_.run(0, num_white, 64, [&](int first, int last, int) {
+         auto num_words = any_t.words_per_row();
+         for (auto w_idx = first; w_idx < last; ++w_idx) {
+            auto any_row = any_t.row(w_idx);
+            auto all_row = all_t.row(w_idx);
+            std::fill(any_row, any_row + num_words, 0);
+            std::fill(all_row, all_row + num_words, ~uint64_t(0));
+            fold_moves(white[w_idx],
+                       wins_t,
+                       col_player1.row(0),
+                       flip_col[w_idx],
+                       any_row,
+                       all_row,
+                       num_words);
+         }
+      });
+      transpose(any, any_t);
+      transpose(all, all_t);
+
+      // ... then black moves. Once a row has been folded, any and all are
+      // replaced by the nodes newly won by player 0 and player 1.
+      pool_.run(0, num_black, 64, [&](int first, int last, int) {
+         auto num_words = any.words_per_row();
+         auto player1 = row_player1.row(0);
+         for (auto b_idx = first; b_idx < last; ++b_idx) {
+            auto any_row = any.row(b_idx);
+            auto all_row = all.row(b_idx);
+            fold_moves(black[b_idx],
+                       wins,
+                       player1,
+                       flip_row[b_idx],
+                       any_row,
+                       all_row,
+                       num_words);
+            auto unsolved_row = unsolved.row(b_idx);
+            for (auto k = 0; k < num_words; ++k) {
+               auto movers1 = flip_row[b_idx] ? ~player1[k] : player1[k];
+               auto won = unsolved_row[k] & any_row[k];
+               auto lost = unsolved_row[k] & ~any_row[k] & all_row[k];
+               any_row[k] = (won & ~movers1) | (lost & movers1);
+               all_row[k] = (won & movers1) | (lost & ~movers1);
+            }
+         }
+      });
+
+      // Record the newly solved nodes. This can't be done in the previous
+      // pass, since other rows were still reading the wins.
+      std::fill(counts_.begin(), counts_.end(), Count{ 0 });
+      pool_.run(0, num_black, 64, [&](int first, int last, int thread) {
+         auto num_words = any.words_per_row();
+         for (auto b_idx = first; b_idx < last; ++b_idx) {
+            uint64_t* solved[num_players] = { any.row(b_idx), all.row(b_idx) };
+            for (auto winner = 0; winner < num_players; ++winner) {
+               auto wins_row = wins[winner].row(b_idx);
+               auto unsolved_row = unsolved.row(b_idx);
+               for (auto k = 0; k < num_words; ++k) {
+                  auto bits = solved[winner][k];
+                  wins_row[k] |= bits;
+                  unsolved_row[k] &= ~bits;
+                  counts_[thread].value += std::popcount(bits);
+                  for (; bits != 0; bits &= bits - 1) {
+                     auto w_idx = k * 64 + std::countr_zero(bits);
+                     strategy_.set_entry(b_idx * num_white + w_idx,
+                                         { winner, depth });
+                  }
+               }
+            }
+         }
+      });
+      auto count = 0;
+      for (auto c : counts_) {
+         count += c.value;
+      }
+      // If no nodes were updated, we can't make any more progress.
+      if (count == 0) {
+         break;
+      }
+
+      transpose(wins_t[0], wins[0]);
+      transpose(wins_t[1], wins[1]);
+   }
+}
+
+void Retrograde::transpose(BitMatrix& dst, const BitMatrix& src)
+{
+   pool_.run_each(src.block_rows(), [&](int index, int) {
+      dst.transpose(src, index, index + 1);
+   });
+}
+
+void Retrograde::analyze_scc()
+{
+   auto begin = std::chrono::steady_clock::now();
+   component_stats_ = {};
+
+   // Terminal nodes are solved up front. They have no successors as far as
+   // the components are concerned, since the game ends there.
+   analyze_nodes(0, true);
+
+   // This is Pearce's space-efficient variant of Tarjan's algorithm, made
+   // iterative so deep searches don't overflow the stack. While a node is
+   // being searched, ids holds its rindex; once its component is complete,
+   // it holds the component's id. Ids count down from num_nodes_ - 1, so
+   // they're always bigger than any rindex. Components are completed in
+   // reverse topological order, so each one can be solved immediately.
+   //
+   // The giant component of a full game can hold most of the graph, so
+   // nothing here grows with the number of edges. While a node is on the
+   // search path, remaining holds the number of its moves searched so far;
+   // once it's off the path, it's reused as in QUEUE.
+   std::vector<int> ids(num_nodes_);
+   std::vector<uint8_t> remaining(num_nodes_);
+   // Set while a node on the path might still be the root of its component.
+   std::vector<bool> root(num_nodes_);
+   // Set while a node's component is being solved.
+   std::vector<bool> members(num_nodes_);
+   // The search path grows up from the bottom, and the nodes waiting for
+   // their component to complete grow down from the top. A node is never in
+   // both, so they can't collide. Only the pages that are used get touched.
+   std::unique_ptr<int[]> stack(new int[num_nodes_]);
+   auto path = 0;
+   auto waiting = num_nodes_;
+   auto rindex = 1;
+   auto id = num_nodes_ - 1;
+
+   for (auto start = 0; start < num_nodes_; ++start) {
+      if ((ids[start] != 0) || !strategy_.contains(start)) {
+         continue;
+      }
+      ids[start] = rindex++;
+      root[start] = true;
+      stack[path++] = start;
+
+      while (path != 0) {
+         auto index = stack[path - 1];
+         auto node = graph_[index];
+         auto terminal = graph_.is_terminal(NodeId(index));
+         auto num_edges = terminal ? 0 : node.num_moves();
+         auto& edge = remaining[index];
+         if (edge < num_edges) {
+            auto next = successor(node, edge);
+            if (ids[next] == 0) {
+               // Descend; the edge is finished when we return.
+               ids[next] = rindex++;
+               root[next] = true;
+               stack[path++] = next;
+               continue;
+            }
+            if (ids[next] < ids[index]) {
+               ids[index] = ids[next];
+               root[index] = false;
+            }
+            ++edge;
+            continue;
+         }
+
+         // All successors have been searched.
+         --path;
+         edge = 0;
+         if (root[index]) {
+            // The component is the root plus the waiting nodes above it,
+            // which are already next to each other at the top of the stack.
+            root[index] = false;
+            auto last = waiting;
+            while ((last < num_nodes_) && (ids[index] <= ids[stack[last]])) {
+               ++last;
+            }
+            stack[--waiting] = index;
+            solve_component({ stack.get() + waiting, stack.get() + last },
+                            id,
+                            ids,
+                            remaining,
+                            members);
+            rindex -= last - waiting;
+            waiting = last;
+            --id;
+         } else {
+            stack[--waiting] = index;
+         }
+
+         // Finish the parent's edge to this node.
+         if (path != 0) {
+            auto parent = stack[path - 1];
+            if (ids[index] < ids[parent]) {
+               ids[parent] = ids[index];
+               root[parent] = false;
+            }
+            ++remaining[parent];
+         }
+      }
+   }
+
+   // Add the per-node arrays to the most any component needed on top.
+   component_stats_.peak_bytes += int64_t(num_nodes_) *
+                                  (sizeof(int) * 2 + sizeof(uint8_t)) +
+                                  int64_t(num_nodes_) * 2 / 8;
+
+   std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - begin;
+   component_stats_.total_seconds = elapsed.count();
+}
+
+void Retrograde::solve_component(std::span<int> component,
+                                 int id,
+                                 std::vector<int>& ids,
+                                 std::vector<uint8_t>& remaining,
+                                 std::vector<bool>& members)
+{
+   int64_t size = component.size();
+   auto& stats = component_stats_;
+   ++stats.components;
+   stats.largest = std::max(stats.largest, size);
+   ++stats.sizes[std::bit_width(static_cast<uint64_t>(size)) - 1];
+
+   // Nodes can't move to themselves, so every successor of a single node has
+   // already been solved.
+   if (size == 1) {
+      ++stats.single_nodes;
+      solve_single_node(component.front());
+      ids[component.front()] = id;
+      return;
+   }
+   stats.cyclic_nodes += size;
+   auto begin = std::chrono::steady_clock::now();
+
+   for (auto index : component) {
+      members[index] = true;
+   }
+
+   // Successors outside the component have already been solved, and only
+   // the one that settles a node matters: its quickest win, or if it has
+   // none, its slowest loss once the others have been counted. Until the
+   // node is solved, its id holds that event's key: twice the depth plus
+   // the winner.
+   constexpr auto no_key = std::numeric_limits<int>::max();
+   auto max_key = 0;
+   for (auto index : component) {
+      auto node = graph_[index];
+      auto win_depth = no_key;
+      auto loss_depth = 0;
+      auto losses = 0;
+      for (auto k = 0; k < node.num_moves(); ++k) {
+         auto next = successor(node, k);
+         auto entry = strategy_.entry(next);
+         if (members[next] || entry.empty()) {
+            continue;
+         }
+         if (entry.winner() == node.player()) {
+            win_depth = std::min(win_depth, entry.depth() + 1);
+         } else {
+            ++losses;
+            loss_depth = std::max(loss_depth, entry.depth() + 1);
+         }
+      }
+      if (win_depth != no_key) {
+         ids[index] = 2 * win_depth + node.player();
+      } else if (losses != 0) {
+         // The event stands in for the last of the losses.
+         remaining[index] = node.num_moves() - losses + 1;
+         ids[index] = 2 * loss_depth + other_player(node.player());
+      } else {
+         ids[index] = no_key;
+         continue;
+      }
+      max_key = std::max(max_key, ids[index]);
+   }
+
+   // Sort the component by key in place, one bucket per key, so the events
+   // can be fed in order of depth. Nodes without one go last.
+   auto bucket = [&](int index) {
+      return (ids[index] == no_key) ? max_key + 1 : ids[index];
+   };
+   std::vector<int> bucket_end(max_key + 2);
+   for (auto index : component) {
+      ++bucket_end[bucket(index)];
+   }
+   std::vector<int> bucket_next(bucket_end.size());
+   std::exclusive_scan(bucket_end.begin(),
+                       bucket_end.end(),
+                       bucket_next.begin(),
+                       0);
+   std::partial_sum(bucket_end.begin(), bucket_end.end(), bucket_end.begin());
+   for (auto b = 0; b < static_cast<int>(bucket_end.size()); ++b) {
+      while (bucket_next[b] < bucket_end[b]) {
+         auto& slot = component[bucket_next[b]];
+         auto target = bucket(slot);
+         if (target == b) {
+            ++bucket_next[b];
+         } else {
+            std::swap(slot, component[bucket_next[target]++]);
+         }
+      }
+   }
+
+   // From here on, this is the same as QUEUE, except that the events from
+   // outside are merged in as their depths come up.
+   std::vector<int> frontier;
+   std::vector<int> next;
+   auto settle = [&](int index, int winner, int depth) {
+      if (!strategy_.entry(index).empty()) {
+         return;
+      }
+
+      // If the player can move to a winner, the node is a winner. If this
+      // was the last move that didn't lose, the node is a loser.
+      auto node = graph_[index];
+      if (winner != node.player()) {
+         auto& count = remaining[index];
+         if (count == 0) {
+            count = node.num_moves();
+         }
+         if (--count != 0) {
+            return;
+         }
+      }
+      strategy_.set_entry(index, { winner, depth });
+      next.push_back(index);
+   };
+
+   auto event = component.begin();
+   for (auto depth = 1; ; ++depth) {
+      if (frontier.empty()) {
+         // Skip ahead to the next event, if there is one.
+         if ((event == component.end()) || (ids[*event] == no_key)) {
+            break;
+         }
+         depth = ids[*event] / 2;
+      }
+      if (!fits(depth)) {
+         break;
+      }
+
+      next.clear();
+      for (; (event != component.end()) && (ids[*event] / 2 == depth);
+           ++event) {
+         settle(*event, ids[*event] % 2, depth);
+      }
+      for (auto index : frontier) {
+         auto winner = strategy_.entry(index).winner();
+         graph_[index].for_each_unmove([&](const Node& unmove) {
+            auto unmove_index = graph_.index(unmove);
+            if (members[unmove_index]) {
+               settle(unmove_index, winner, depth);
+            }
+         });
+      }
+      std::swap(frontier, next);
+   }
+
+   for (auto index : component) {
+      ids[index] = id;
+      members[index] = false;
+   }
+
+   int64_t bytes = sizeof(int) * (frontier.capacity() +
+                                  next.capacity() +
+                                  bucket_end.capacity() +
+                                  bucket_next.capacity());
+   stats.peak_bytes = std::max(stats.peak_bytes, bytes);
+   std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - begin;
+   stats.cyclic_seconds += elapsed.count();
+}
+
+void Retrograde::solve_single_node(int index)
+{
+   // Terminal nodes were solved by pass zero.
+   if (!strategy_.entry(index).empty()) {
+      return;
+   }
+
+   // A winner takes the quickest win; a loser holds out as long as possible.
+   auto node = graph_[index];
+   auto win_depth = std::numeric_limits<int>::max();
+   auto loss_depth = 0;
+   auto all_lose = true;
+   for (auto k = 0; k < node.num_moves(); ++k) {
+      auto entry = strategy_.entry(successor(node, k));
+      if (entry.empty()) {
+         all_lose = false;
+      } else if (entry.winner() == node.player()) {
+         win_depth = std::min(win_depth, entry.depth() + 1);
+      } else {
+         loss_depth = std::max(loss_depth, entry.depth() + 1);
+      }
+   }
+
+   if (win_depth != std::numeric_limits<int>::max()) {
+      if (fits(win_depth)) {
+         strategy_.set_entry(index, { node.player(), win_depth });
+      }
+   } else if (all_lose) {
+      if (fits(loss_depth)) {
+         strategy_.set_entry(index,
+                             { other_player(node.player()), loss_depth });
+      }
+   }
+}
+
+bool Retrograde::fits(int depth)
+{
+   // Deep wins are rare, so start with narrow entries and only pay for wide
+   // ones once they're needed.
+   if ((depth >= std::min(widen_depth_, strategy_.max_depth())) &&
+       !strategy_.wide()) {
+      strategy_.widen();
+   }
+   return depth < strategy_.max_depth();
+}
+
+int Retrograde::successor(const Node& node, int k) const noexcept
+{
+   auto num_white = graph_.white().size();
+   auto [b_idx, w_idx] = node.indices();
+   auto black_moves = graph_.black()[b_idx]->moves(node.player());
+   if (k < black_moves.size()) {
+      return black_moves[k]->index * num_white + w_idx;
+   }
+   auto white_moves = graph_.white()[w_idx]->moves(node.player());
+   return b_idx * num_white + white_moves[k - black_moves.size()]->index;
+}
@@ -8,28 +8,192 @@
 #ifndef Retrograde_h
 #define Retrograde_h
 
+#include "BitMatrix.h"
 #include "Strategy.h"
+#include "ThreadPool.h"
+#include <array>
+#include <span>
 
 // Performs retrograde analysis to strongly solve the graph.
 class Retrograde
 {
 public:
-   Retrograde(const Graph& graph);
+   // Algorithms for solving the graph. All of them produce the same winners.
+   enum Algorithm
+   {
+      // Revisits every unsolved node once per depth. Nodes solved earlier in
+      // the same pass are used right away, so fewer passes are needed, but
+      // the depths depend on the order in which threads visit the nodes.
+      SWEEP,
+      // Like SWEEP, but each pass only uses nodes solved by previous passes,
+      // so the depths are deterministic and match QUEUE.
+      LOCKSTEP,
+      // Solves whole rows of nodes at a time with bitwise operations. Since
+      // every move changes only the black or only the white ColorNode,
+      // the successors of a row are other rows (or columns). Depths match
+      // QUEUE.
+      BITWISE,
+      // Solves the strongly connected components of the graph one at a time
+      // in reverse topological order. Components without cycles are solved
+      // in a single step, so only the cyclic ones need iterating. Depths
+      // match QUEUE. Records statistics about the components. Needs about 10
+      // bytes per node on top of the strategy however big the components
+      // are, but visits every edge, so it's much slower than QUEUE when most
+      // nodes are draws.
+      SCC,
+      // Propagates solved nodes backwards along their unmoves, so each edge
+      // is only visited a constant number of times.
+      QUEUE
+   };
+
+   // Statistics about the components found by the SCC algorithm.
+   struct ComponentStats
+   {
+      // Number of components, and how many of them are a single node.
+      int64_t components = 0;
+      int64_t single_nodes = 0;
+      // Size of the largest component.
+      int64_t largest = 0;
+      // Total number of nodes in components of more than one node.
+      int64_t cyclic_nodes = 0;
+      // sizes[i] is the number of components with [2^i, 2^(i+1)) nodes.
+      std::array<int64_t, 32> sizes = {};
+      // Most memory the search needed at once, in bytes, counting all of its
+      // stack but not the strategy or the graph.
+      int64_t peak_bytes = 0;
+      // Time spent finding the components and solving the cyclic ones.
+      double total_seconds = 0;
+      double cyclic_seconds = 0;
+   };
+
+   // If num_threads is zero, uses one thread per hardware thread. If
+   // reachable_only is set, only the nodes reachable from the starting
+   // position are solved and stored; every other node is left a draw.
+   Retrograde(const Graph& graph,
+              int num_threads = 0,
+              bool reachable_only = false);
    // Solves the graph and returns the value of the starting position.
-   int analyze();
+   int analyze(Algorithm algorithm = SWEEP);
+   // Records the best move from every solved node in the strategy from a
+   // previous call to analyze, so play doesn't have to search for it.
+   void add_best_moves();
    // Returns the strategy generated by a previous call to analyze.
    const Strategy& strategy() const noexcept;
+   // Widens the strategy's entries once this depth is reached instead of when
+   // the narrow entries run out. Used by tests, since no small variant is deep
+   // enough to need wide entries.
+   void set_widen_depth(int depth) noexcept;
+   // Returns the statistics from a previous call to analyze(SCC).
+   const ComponentStats& component_stats() const noexcept;
    
 private:
-   bool analyze_node_zero(const Node& node) noexcept;
-   bool analyze_node(const Node& node, int depth) noexcept;
-   int analyze_nodes_worker(int index, int depth) noexcept;
-   int analyze_nodes(int depth);
+   // Nodes waiting to be analyzed while their successors' entries are
+   // prefetched, so a worker isn't stalled on memory for each node in turn.
+   struct Batch
+   {
+      // Number of nodes analyzed together.
+      static constexpr int capacity = 32;
+
+      struct Pending
+      {
+         NodeId id;
+         int player;
+         // Range of the node's successors in successors.
+         int first;
+         int last;
+      };
+      std::vector<Pending> nodes;
+      std::vector<int> successors;
+   };
+
+   // Drops the nodes that aren't stored from mask, a word of a row of the
+   // unsolved bitmap.
+   uint64_t stored(int b_idx, int word, uint64_t mask) const noexcept;
+   // Solves the terminal nodes in mask, a word of a row of the unsolved
+   // bitmap, and returns them.
+   uint64_t analyze_terminals(int b_idx, int word, uint64_t mask) noexcept;
+   bool analyze_node(NodeId id,
+                     int player,
+                     const int* successors,
+                     int num_successors,
+                     int depth,
+                     bool lockstep) noexcept;
+   // Adds the node with the given black and white indices to the batch and
+   // prefetches its successors.
+   void add_to_batch(Batch& batch, int b_idx, int w_idx) const;
+   // Analyzes and empties the batch, invoking func(pending, solved) for each
+   // node in the order they were added.
+   template<class Func>
+   int analyze_batch(Batch& batch, int depth, bool lockstep, Func func);
+   int analyze_tile_worker(const Graph::Tile& tile,
+                           int depth,
+                           bool lockstep,
+                           Batch& batch);
+   int analyze_worklist_worker(int first,
+                               int last,
+                               int depth,
+                               bool lockstep,
+                               Batch& batch);
+   int analyze_nodes(int depth, bool lockstep);
+   void update_worklist(int num_solved);
+   void analyze_sweep(bool lockstep);
+   void analyze_queue();
+   void analyze_bitwise();
+   void analyze_scc();
+   void solve_component(std::span<int> component,
+                        int id,
+                        std::vector<int>& ids,
+                        std::vector<uint8_t>& remaining,
+                        std::vector<bool>& members);
+   void solve_single_node(int index);
+   // Returns true if entries at the given depth can be stored, widening the
+   // strategy's entries if necessary. Widening replaces the table, so no
+   // other thread may be touching the strategy.
+   bool fits(int depth);
+   // Returns the index of the successor reached by the node's k-th move.
+   int successor(const Node& node, int k) const noexcept;
+   void transpose(BitMatrix& dst, const BitMatrix& src);
+
+   // Number of nodes each worker claims at a time from the worklist. Big
+   // enough to amortize the cost of claiming a chunk, small enough to
+   // balance the load.
+   static constexpr int chunk_size = 4096;
+   // Shape of the tiles swept by each worker. The columns are a multiple of
+   // 64, so each word of the unsolved bitmap belongs to a single tile.
+   static constexpr int tile_rows = 256;
+   static constexpr int tile_cols = 64;
+
+   // Number of nodes solved by each worker. Padded, so the workers don't
+   // share cache lines.
+   struct alignas(64) Count
+   {
+      int value;
+   };
 
-   const int num_workers_;
+   ThreadPool pool_;
+   std::vector<Count> counts_;
+   // Each worker's batch, kept between passes so its buffers are only
+   // allocated once.
+   std::vector<Batch> batches_;
+   // One bit per node that's set while the node is unsolved, so passes can
+   // skip 64 solved nodes at a time. Laid out by black row and white column
+   // like the tiles, so each word is only ever written by the worker that
+   // owns the tile.
+   BitMatrix unsolved_;
+   // Once few nodes are left, passes iterate over an explicit list of the
+   // unsolved nodes instead, which is compacted after every pass. It isn't
+   // used from the start, since it costs four bytes per node.
+   bool use_worklist_ = false;
+   int num_unsolved_ = 0;
+   std::vector<NodeId> worklist_;
+   // Number of nodes left in each chunk of the worklist after a pass.
+   std::vector<int> worklist_kept_;
    const int num_nodes_;
    const Graph& graph_;
    Strategy strategy_;
+   // Depth at which fits() widens the strategy's entries.
+   int widen_depth_ = Strategy::Entry8::max_depth();
+   ComponentStats component_stats_;
 };
 
 inline const Strategy& Retrograde::strategy() const noexcept
@@ -37,4 +201,15 @@ inline const Strategy& Retrograde::strategy() const noexcept
    return strategy_;
 }
 
+inline void Retrograde::set_widen_depth(int depth) noexcept
+{
+   widen_depth_ = depth;
+}
+
+inline const Retrograde::ComponentStats&
+Retrograde::component_stats() const noexcept
+{
+   return component_stats_;
+}
+
 #endif /* Retrograde_h */
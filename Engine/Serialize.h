@@ -0,0 +1,91 @@
+//
+// Copyright 2023 Stephen E. Bensley
+//
+// This file is licensed under the MIT License. You may obtain a copy of the
+// license at https://github.com/stephenbensley/FiveFieldKono/blob/main/LICENSE.
+//
+
+#ifndef Serialize_h
+#define Serialize_h
+
+#include <cstdint>
+#include <cstring>
+#include <istream>
+#include <ostream>
+#include <vector>
+
+// Helpers for reading and writing binary data. Values are stored in native
+// byte order, so files aren't portable across architectures. Callers are
+// expected to detect this with a magic number.
+
+template<class T>
+void write(std::ostream& ostrm, const T& value)
+{
+   ostrm.write(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+template<class T>
+bool read(std::istream& istrm, T& value)
+{
+   return static_cast<bool>(istrm.read(reinterpret_cast<char*>(&value),
+                                       sizeof(T)));
+}
+
+// Vectors are stored as the number of elements followed by the elements. A
+// count larger than the rest of the stream fails the read instead of
+// allocating, so the stream must be seekable.
+template<class T>
+void write(std::ostream& ostrm, const std::vector<T>& values)
+{
+   write(ostrm, static_cast<uint64_t>(values.size()));
+   ostrm.write(reinterpret_cast<const char*>(values.data()),
+               sizeof(T) * values.size());
+}
+
+template<class T>
+bool read(std::istream& istrm, std::vector<T>& values)
+{
+   uint64_t size;
+   if (!read(istrm, size)) {
+      return false;
+   }
+   auto begin = istrm.tellg();
+   istrm.seekg(0, std::ios::end);
+   auto end = istrm.tellg();
+   istrm.seekg(begin);
+   if ((begin < 0) || (end < begin) ||
+       (size > static_cast<uint64_t>(end - begin) / sizeof(T))) {
+      istrm.setstate(std::ios::failbit);
+      return false;
+   }
+   values.resize(size);
+   return static_cast<bool>(istrm.read(reinterpret_cast<char*>(values.data()),
+                                       sizeof(T) * values.size()));
+}
+
+// 64-bit FNV-1a style hash that consumes eight bytes at a time, so it can
+// keep up with the disk. Pass in a previous result to hash data in pieces.
+constexpr uint64_t hash_basis = 0xcbf29ce484222325;
+uint64_t hash_bytes(const void* data,
+                    size_t size,
+                    uint64_t hash = hash_basis) noexcept;
+
+inline uint64_t hash_bytes(const void* data,
+                           size_t size,
+                           uint64_t hash) noexcept
+{
+   constexpr uint64_t prime = 0x100000001b3;
+   auto bytes = static_cast<const unsigned char*>(data);
+   size_t i = 0;
+   for (; i + sizeof(uint64_t) <= size; i += sizeof(uint64_t)) {
+      uint64_t word;
+      std::memcpy(&word, bytes + i, sizeof(word));
+      hash = (hash ^ word) * prime;
+   }
+   for (; i < size; ++i) {
+      hash = (hash ^ bytes[i]) * prime;
+   }
+   return hash;
+}
+
+#endif /* Serialize_h */
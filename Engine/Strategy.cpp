@@ -6,41 +6,95 @@
 //
 
 #include "Strategy.h"
+#include "Serialize.h"
 #include <fstream>
 #include <limits>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+// Concurrent solvers rely on entries being updated without locks.
+static_assert(std::atomic_ref<Strategy::Entry8>::is_always_lock_free);
+static_assert(std::atomic_ref<Strategy::Entry16>::is_always_lock_free);
 
 Strategy::Strategy(const Graph& graph)
-: graph_(graph)
+: Strategy(graph, nullptr)
 {
-   entries_.resize(graph_.size());
+   allocate();
 }
 
-Node Strategy::best_move(const Node& from) const noexcept
+Strategy::Strategy(const Graph& graph, NodeSet nodes)
+: Strategy(graph, nullptr)
+{
+   assert(nodes.size() == graph_.size());
+   compact_ = true;
+   nodes_ = std::move(nodes);
+   allocate();
+}
+
+Strategy::Strategy(const Graph& graph, std::nullptr_t) noexcept
+: graph_(graph),
+  compact_(false),
+  wide_(false),
+  table_(nullptr),
+  best_move_table_(nullptr),
+  mapping_(nullptr),
+  mapping_bytes_(0)
+{ }
+
+Strategy::~Strategy() noexcept
+{
+   unmap();
+}
+
+void Strategy::add_best_moves()
+{
+   assert(mapping_ == nullptr);
+   best_moves_.assign(num_entries(), no_move);
+   best_move_table_ = best_moves_.data();
+}
+
+int Strategy::find_best_move(const Node& from) const noexcept
 {
    assert(!from.is_terminal());
 
    auto color = from.player() ? -1 : +1;
 
-   auto moves = from.moves();
-   assert(!moves.empty());
    // In the case of ties, prefer more aggressive moves. Not that it reallly
    // matters, but it's as good a tiebreaker as any.
-   std::sort(moves.begin(), moves.end(), [](auto lhs, auto rhs) {
-      return lhs.distance() < rhs.distance();
-   });
-
+   auto best = -1;
    auto best_value = std::numeric_limits<int>::min();
-   Node best_move;
-   for (auto move : moves) {
+   auto best_distance = std::numeric_limits<int>::max();
+   for (auto k = 0; k < from.num_moves(); ++k) {
+      auto move = from.move(k);
       auto move_value = color * find(move).value();
-      if (move_value > best_value) {
+      auto move_distance = move.distance();
+      if ((move_value > best_value) ||
+          ((move_value == best_value) && (move_distance < best_distance))) {
+         best = k;
          best_value = move_value;
-         best_move = move;
+         best_distance = move_distance;
       }
    }
 
-   assert(!best_move.is_null());
-   return best_move;
+   assert(best >= 0);
+   return best;
+}
+
+Node Strategy::best_move(const Node& from) const noexcept
+{
+   assert(!from.is_terminal());
+
+   if (has_best_moves()) {
+      auto index = graph_.index(from);
+      if (contains(index)) {
+         auto move = best_move_table_[slot(index)];
+         if (move != no_move) {
+            return from.move(move);
+         }
+      }
+   }
+   return from.move(find_best_move(from));
 }
 
 bool Strategy::load(const char* filename)
@@ -50,8 +104,7 @@ bool Strategy::load(const char* filename)
       return false;
    }
 
-   auto bytes = sizeof(Entry) * entries_.size();
-   if (!istrm.read(reinterpret_cast<char*>(entries_.data()), bytes)) {
+   if (!load(istrm)) {
       return false;
    }
 
@@ -61,16 +114,210 @@ bool Strategy::load(const char* filename)
 void Strategy::save(const char* filename) const noexcept
 {
    std::ofstream ostrm(filename, std::ios::binary | std::ios::trunc);
-   auto bytes = sizeof(Entry) * entries_.size();
-   ostrm.write(reinterpret_cast<const char*>(entries_.data()), bytes);
+   save(ostrm);
 }
 
-Strategy::Entry Strategy::find(const Node& node) const noexcept
+bool Strategy::load(std::istream& istrm)
 {
-   return entries_[graph_.index(node)];
+   auto best_moves = has_best_moves();
+   unmap();
+   if (compact_) {
+      if (!istrm.read(reinterpret_cast<char*>(nodes_.words()),
+                      sizeof(uint64_t) * nodes_.num_words())) {
+         return false;
+      }
+      nodes_.build_index();
+   }
+   allocate();
+   if (!istrm.read(table<char>(), entry_bytes() * num_entries())) {
+      return false;
+   }
+   if (best_moves) {
+      add_best_moves();
+      return static_cast<bool>(
+         istrm.read(reinterpret_cast<char*>(best_moves_.data()),
+                    best_move_bytes()));
+   }
+   return true;
+}
+
+void Strategy::save(std::ostream& ostrm) const noexcept
+{
+   if (compact_) {
+      ostrm.write(reinterpret_cast<const char*>(nodes_.words()),
+                  sizeof(uint64_t) * nodes_.num_words());
+   }
+   ostrm.write(table<const char>(), entry_bytes() * num_entries());
+   if (has_best_moves()) {
+      ostrm.write(reinterpret_cast<const char*>(best_move_table_),
+                  best_move_bytes());
+   }
 }
 
-Strategy::Entry& Strategy::find(const Node& node) noexcept
+std::unique_ptr<Strategy> Strategy::map(const Graph& graph,
+                                        const char* filename,
+                                        uint64_t offset,
+                                        Layout layout,
+                                        bool prefetch)
 {
-   return entries_[graph_.index(node)];
+   std::unique_ptr<Strategy> result(new Strategy(graph, nullptr));
+   result->wide_ = layout.wide;
+
+   // The set of nodes is small and needs a rank index anyway, so read it
+   // into memory and only map the entries.
+   if (layout.compact) {
+      result->compact_ = true;
+      result->nodes_ = NodeSet(graph.size());
+      auto& nodes = result->nodes_;
+      std::ifstream istrm(filename, std::ios::binary);
+      istrm.seekg(static_cast<std::streamoff>(offset));
+      if (!istrm.read(reinterpret_cast<char*>(nodes.words()),
+                      sizeof(uint64_t) * nodes.num_words())) {
+         return nullptr;
+      }
+      nodes.build_index();
+      offset += sizeof(uint64_t) * nodes.num_words();
+   }
+
+   auto fd = open(filename, O_RDONLY);
+   if (fd < 0) {
+      return nullptr;
+   }
+
+   // Mappings must start on a page boundary, so map from the start of the
+   // page containing the offset.
+   auto page_size = static_cast<uint64_t>(sysconf(_SC_PAGESIZE));
+   auto page_offset = offset % page_size;
+   auto entries_bytes = result->entry_bytes() * result->num_entries();
+   auto map_bytes = page_offset + entries_bytes +
+                    (layout.best_moves ? result->num_entries() : 0);
+   auto mapping = mmap(nullptr,
+                       map_bytes,
+                       PROT_READ,
+                       MAP_SHARED,
+                       fd,
+                       static_cast<off_t>(offset - page_offset));
+   // The mapping stays valid after the file is closed.
+   close(fd);
+   if (mapping == MAP_FAILED) {
+      return nullptr;
+   }
+
+   // Probes are scattered all over the table, so read-ahead doesn't help
+   // unless we want the whole thing.
+   madvise(mapping, map_bytes, prefetch ? MADV_WILLNEED : MADV_RANDOM);
+
+   result->mapping_ = mapping;
+   result->mapping_bytes_ = map_bytes;
+   result->table_ = static_cast<const char*>(mapping) + page_offset;
+   if (layout.best_moves) {
+      result->best_move_table_ =
+         static_cast<const uint8_t*>(mapping) + page_offset + entries_bytes;
+   }
+   return result;
+}
+
+bool Strategy::translate(const Strategy& original)
+{
+   assert(mapping_ == nullptr);
+   assert(original.graph_.size() == graph_.size());
+   assert(original.wide_ == wide_);
+   assert(original.has_best_moves() == has_best_moves());
+   if (original.num_entries() != num_entries()) {
+      return false;
+   }
+   for (auto i = 0; i < graph_.size(); ++i) {
+      auto j = graph_.original_index(i);
+      if (original.contains(j) != contains(i)) {
+         return false;
+      }
+      if (!contains(i)) {
+         continue;
+      }
+      set_entry(i, original.entry(j));
+      if (has_best_moves()) {
+         // Renumbering keeps the order of the moves.
+         best_moves_[slot(i)] = original.best_move_table_[original.slot(j)];
+      }
+   }
+   return true;
+}
+
+size_t Strategy::bytes() const noexcept
+{
+   auto bytes = entry_bytes() * num_entries() + best_move_bytes();
+   if (compact_) {
+      bytes += sizeof(uint64_t) * nodes_.num_words();
+   }
+   return bytes;
+}
+
+uint64_t Strategy::hash() const noexcept
+{
+   auto hash = hash_basis;
+   if (compact_) {
+      hash = hash_bytes(nodes_.words(),
+                        sizeof(uint64_t) * nodes_.num_words(),
+                        hash);
+   }
+   hash = hash_bytes(table_, entry_bytes() * num_entries(), hash);
+   return hash_bytes(best_move_table_, best_move_bytes(), hash);
+}
+
+void Strategy::widen()
+{
+   assert(mapping_ == nullptr);
+   if (wide_) {
+      return;
+   }
+   entries16_.clear();
+   entries16_.reserve(entries8_.size());
+   for (auto entry : entries8_) {
+      entries16_.emplace_back(entry);
+   }
+   std::vector<Entry8>().swap(entries8_);
+   wide_ = true;
+   table_ = entries16_.data();
+}
+
+void Strategy::allocate()
+{
+   if (wide_) {
+      entries16_.assign(num_entries(), Entry16{});
+      table_ = entries16_.data();
+   } else {
+      entries8_.assign(num_entries(), Entry8{});
+      table_ = entries8_.data();
+   }
+}
+
+void Strategy::unmap() noexcept
+{
+   if (mapping_ != nullptr) {
+      munmap(mapping_, mapping_bytes_);
+      mapping_ = nullptr;
+      mapping_bytes_ = 0;
+      table_ = nullptr;
+      best_move_table_ = nullptr;
+   }
+}
+
+size_t Strategy::best_move_bytes() const noexcept
+{
+   return has_best_moves() ? num_entries() : 0;
+}
+
+int Strategy::num_entries() const noexcept
+{
+   return compact_ ? nodes_.count() : graph_.size();
+}
+
+Strategy::Entry Strategy::find(const Node& node) const noexcept
+{
+   auto index = graph_.index(node);
+   if (!contains(index)) {
+      return Entry{};
+   }
+   auto slot = this->slot(index);
+   return wide_ ? table<Entry16>()[slot] : Entry(table<Entry8>()[slot]);
 }
@@ -9,74 +9,335 @@
 #define Strategy_h
 
 #include "Graph.h"
+#include "NodeSet.h"
+#include <atomic>
+#include <cstdlib>
 #include <limits>
+#include <memory>
 
 // Implements an optimal strategy for the game.
+//
+// The game is symmetric under swapping the players and reflecting the board
+// vertically, but there's no need to exploit this to shrink the table.
+// Swapping doesn't change a node's parity, so the swapped position with the
+// other player to move never appears in the graph. The table already stores
+// only one member of each symmetric pair.
 class Strategy
 {
 public:
    Strategy(const Graph& graph);
+   // Only stores entries for the nodes in the set, typically the nodes
+   // reachable from the start position. Every other node is a draw. The
+   // set's rank index must already be built.
+   Strategy(const Graph& graph, NodeSet nodes);
+   ~Strategy() noexcept;
+   // Can't be copied since it may own a memory mapping.
+   Strategy(const Strategy&) = delete;
+   Strategy& operator=(const Strategy&) = delete;
+
+   // Graph for which this is the strategy.
+   const Graph& graph() const noexcept;
+   // Returns true if the strategy only stores a subset of the nodes.
+   bool compact() const noexcept;
+   // Returns true if the strategy stores an entry for the node.
+   bool contains(int index) const noexcept;
+   // Number of entries stored.
+   int num_entries() const noexcept;
 
-   // The maximum supported depth. If the game has a deeper graph, this class
-   // will have to be updated.
-   static constexpr int max_depth() noexcept;
+   // Returns true if the entries are 16 bits instead of 8.
+   bool wide() const noexcept;
+   // Switches to 16-bit entries, keeping the existing contents, so deeper
+   // wins can be stored. Must not be called while entries are being loaded
+   // or stored, and not on a mapped strategy.
+   void widen();
+   // The maximum depth the entries can currently hold.
+   int max_depth() const noexcept;
 
+   // Returns true if the strategy has a table of best moves, so best_move
+   // doesn't have to search.
+   bool has_best_moves() const noexcept;
+   // Allocates an empty table of best moves. Must not be called on a mapped
+   // strategy.
+   void add_best_moves();
+   // Records the best move for a stored node as an index into
+   // Node::moves(). Different nodes may be set concurrently. Only used when
+   // building a new strategy.
+   void set_best_move(int index, int move) noexcept;
+   // Returns the index into Node::moves() of the best move for a
+   // non-terminal node, searching the successors' entries. In the case of
+   // ties, prefers more aggressive moves, and then earlier ones.
+   int find_best_move(const Node& from) const noexcept;
    // Returns the best move for the current position.
    Node best_move(const Node& from) const noexcept;
 
+   // Which optional parts a strategy has, since they determine how it's
+   // saved.
+   struct Layout
+   {
+      bool compact = false;
+      bool wide = false;
+      bool best_moves = false;
+   };
+   Layout layout() const noexcept;
+
    // Load/save the strategy from/to a file.
    bool load(const char* filename);
    void save(const char* filename) const noexcept;
+   // Load/save the strategy from/to a stream. The strategy must already
+   // have the layout of the saved one.
+   bool load(std::istream& istrm);
+   void save(std::ostream& ostrm) const noexcept;
+   // Memory maps a strategy previously saved at the given offset of the file
+   // instead of reading it, so startup is constant time, pages are only read
+   // on demand, and processes share a single copy. If prefetch is true, the
+   // OS is asked to start reading the entire strategy in the background. The
+   // strategy is read-only. Compact strategies read their set of nodes up
+   // front. Returns nullptr if the file can't be mapped.
+   static std::unique_ptr<Strategy> map(const Graph& graph,
+                                        const char* filename,
+                                        uint64_t offset,
+                                        Layout layout,
+                                        bool prefetch = false);
+   // Copies the contents of a strategy for this strategy's graph as it was
+   // before renumbering. The layouts must match. Returns false if the
+   // strategies don't store the same nodes. Must not be called on a mapped
+   // strategy.
+   bool translate(const Strategy& original);
+   // Size in bytes of the saved strategy. Compact strategies save their set
+   // of nodes first, then come the entries, then the best moves, if any.
+   size_t bytes() const noexcept;
+   // Hash of the strategy's contents, used to validate saved strategies.
+   uint64_t hash() const noexcept;
 
-   // Entry for a node in the strategy table.
-   class Entry
+   // Entry for a node in the strategy table. The winner and depth are packed
+   // into a single signed value of type T, which limits the depth.
+   template<typename T>
+   class BasicEntry
    {
    public:
-      Entry() = default;
-      Entry(int winner, int depth) noexcept;
+      BasicEntry() = default;
+      BasicEntry(int winner, int depth) noexcept;
+      // Converts between widths. The depth must fit.
+      template<typename U>
+      explicit BasicEntry(BasicEntry<U> other) noexcept;
+      // The maximum depth that can be stored.
+      static constexpr int max_depth() noexcept;
       bool empty() const noexcept;
       int winner() const noexcept;
+      int depth() const noexcept;
       int value() const noexcept;
 
    private:
-      char value_;
+      template<typename U>
+      friend class BasicEntry;
+
+      T value_;
    };
+   using Entry8 = BasicEntry<int8_t>;
+   using Entry16 = BasicEntry<int16_t>;
+   // Entries are loaded and stored at full width regardless of how the table
+   // stores them.
+   using Entry = Entry16;
 
+   // Atomically loads or stores an entry, so workers can solve nodes
+   // concurrently. Ordering is relaxed; the caller must synchronize between
+   // passes. Nodes that aren't stored load as empty, and can't be stored.
    // Only used when building a new strategy.
-   Entry& find(const Node& node) noexcept;
+   Entry entry(int index) const noexcept;
+   void set_entry(int index, Entry entry) noexcept;
+   // Hints that the entry will be loaded soon, so it can be fetched into the
+   // cache while the caller does other work.
+   void prefetch(int index) const noexcept;
 
 private:
+   // Best move of a node that hasn't been set, such as a terminal node.
+   static constexpr int no_move = 0xff;
+
+   // Constructs a strategy without any entries, so they can be mapped.
+   Strategy(const Graph& graph, std::nullptr_t) noexcept;
+   // Allocates zeroed entries of the current width.
+   void allocate();
+   // Releases the memory mapping, if any.
+   void unmap() noexcept;
+   // Position of the node's entry in the table.
+   int slot(int index) const noexcept;
+   // Size of each entry in the table.
+   size_t entry_bytes() const noexcept;
+   // Size of the best-move table, if any.
+   size_t best_move_bytes() const noexcept;
+   // Returns the entries currently in use as the given width.
+   template<typename E>
+   E* table() const noexcept;
+
    Entry find(const Node& node) const noexcept;
 
    const Graph& graph_;
-   std::vector<Entry> entries_;
+   // Nodes stored by a compact strategy.
+   bool compact_;
+   NodeSet nodes_;
+   bool wide_;
+   // Entries of a strategy that isn't mapped. Only the vector matching the
+   // width is used.
+   std::vector<Entry8> entries8_;
+   std::vector<Entry16> entries16_;
+   // Entries currently in use, either one of the vectors or the mapped file.
+   const void* table_;
+   // Best move for each entry, either best_moves_ or the mapped file. Null
+   // if there's no table.
+   std::vector<uint8_t> best_moves_;
+   const uint8_t* best_move_table_;
+   // Memory mapping, if any.
+   void* mapping_;
+   size_t mapping_bytes_;
 };
 
-constexpr int Strategy::max_depth() noexcept
+inline const Graph& Strategy::graph() const noexcept
 {
-   // Anything bigger than this will cause an overflow in the constructor.
-   return std::numeric_limits<char>::max() - 1;
+   return graph_;
+}
+
+inline bool Strategy::compact() const noexcept
+{
+   return compact_;
+}
+
+inline bool Strategy::contains(int index) const noexcept
+{
+   return !compact_ || nodes_.contains(index);
+}
+
+inline bool Strategy::wide() const noexcept
+{
+   return wide_;
+}
+
+inline int Strategy::max_depth() const noexcept
+{
+   return wide_ ? Entry16::max_depth() : Entry8::max_depth();
+}
+
+inline bool Strategy::has_best_moves() const noexcept
+{
+   return best_move_table_ != nullptr;
+}
+
+inline void Strategy::set_best_move(int index, int move) noexcept
+{
+   assert(mapping_ == nullptr);
+   assert(move < no_move);
+   best_moves_[slot(index)] = static_cast<uint8_t>(move);
+}
+
+inline Strategy::Layout Strategy::layout() const noexcept
+{
+   return { compact_, wide_, has_best_moves() };
+}
+
+inline int Strategy::slot(int index) const noexcept
+{
+   assert(contains(index));
+   return compact_ ? nodes_.rank(index) : index;
 }
 
-inline Strategy::Entry::Entry(int winner, int depth) noexcept
+inline size_t Strategy::entry_bytes() const noexcept
+{
+   return wide_ ? sizeof(Entry16) : sizeof(Entry8);
+}
+
+template<typename E>
+inline E* Strategy::table() const noexcept
+{
+   // Only the solver writes, and only to entries it owns.
+   return const_cast<E*>(static_cast<const E*>(table_));
+}
+
+template<typename T>
+inline Strategy::BasicEntry<T>::BasicEntry(int winner, int depth) noexcept
 : value_(winner ? -(depth + 1) : (depth + 1))
 {
    assert(depth <= max_depth());
 }
 
-inline bool Strategy::Entry::empty() const noexcept
+template<typename T>
+template<typename U>
+inline Strategy::BasicEntry<T>::BasicEntry(BasicEntry<U> other) noexcept
+: value_(static_cast<T>(other.value_))
+{
+   assert(other.value_ == value_);
+}
+
+template<typename T>
+constexpr int Strategy::BasicEntry<T>::max_depth() noexcept
+{
+   // Anything bigger than this will cause an overflow in the constructor.
+   return std::numeric_limits<T>::max() - 1;
+}
+
+template<typename T>
+inline bool Strategy::BasicEntry<T>::empty() const noexcept
 {
    return value_ == 0;
 }
 
-inline int Strategy::Entry::winner() const noexcept
+template<typename T>
+inline int Strategy::BasicEntry<T>::winner() const noexcept
 {
    return (value_ > 0) ? 0 : 1;
 }
 
-inline int Strategy::Entry::value() const noexcept
+template<typename T>
+inline int Strategy::BasicEntry<T>::depth() const noexcept
+{
+   return std::abs(value_) - 1;
+}
+
+template<typename T>
+inline int Strategy::BasicEntry<T>::value() const noexcept
 {
    return value_;
 }
 
+inline Strategy::Entry Strategy::entry(int index) const noexcept
+{
+   assert(mapping_ == nullptr);
+   // Fast path for the common case of a full table with narrow entries.
+   if (!compact_ && !wide_) {
+      return Entry(std::atomic_ref<Entry8>(table<Entry8>()[index]).load(
+         std::memory_order_relaxed));
+   }
+   if (!contains(index)) {
+      return Entry{};
+   }
+   auto slot = this->slot(index);
+   if (wide_) {
+      return std::atomic_ref<Entry16>(table<Entry16>()[slot]).load(
+         std::memory_order_relaxed);
+   }
+   return Entry(std::atomic_ref<Entry8>(table<Entry8>()[slot]).load(
+      std::memory_order_relaxed));
+}
+
+inline void Strategy::set_entry(int index, Entry entry) noexcept
+{
+   assert(mapping_ == nullptr);
+   auto slot = this->slot(index);
+   if (wide_) {
+      std::atomic_ref<Entry16>(table<Entry16>()[slot]).store(
+         entry,
+         std::memory_order_relaxed);
+   } else {
+      std::atomic_ref<Entry8>(table<Entry8>()[slot]).store(
+         Entry8(entry),
+         std::memory_order_relaxed);
+   }
+}
+
+inline void Strategy::prefetch(int index) const noexcept
+{
+   if (contains(index)) {
+      __builtin_prefetch(static_cast<const char*>(table_) +
+                         entry_bytes() * slot(index));
+   }
+}
+
 #endif /* Strategy_h */
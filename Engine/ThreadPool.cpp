@@ -0,0 +1,131 @@
+//
+// Copyright 2023 Stephen E. Bensley
+//
+// This file is licensed under the MIT License. You may obtain a copy of the
+// license at https://github.com/stephenbensley/FiveFieldKono/blob/main/LICENSE.
+//
+
+#include "ThreadPool.h"
+#include "Parallel.h"
+#include <algorithm>
+
+ThreadPool::ThreadPool(int num_threads)
+: num_threads_((num_threads > 0) ? num_threads : num_hardware_threads()),
+  blocks_(new Block[num_threads_])
+{
+   // The calling thread acts as thread zero, so we only launch the rest.
+   for (auto i = 1; i < num_threads_; ++i) {
+      threads_.emplace_back(&ThreadPool::worker, this, i);
+   }
+}
+
+ThreadPool::~ThreadPool()
+{
+   {
+      std::lock_guard<std::mutex> lock(mutex_);
+      exit_ = true;
+   }
+   start_.notify_all();
+   for (auto& t : threads_) {
+      t.join();
+   }
+}
+
+void ThreadPool::run(int begin,
+                     int end,
+                     int chunk_size,
+                     const std::function<void(int, int, int)>& func)
+{
+   chunk_size = std::max(chunk_size, chunk_alignment);
+   chunk_size -= chunk_size % chunk_alignment;
+   run_chunks(begin, end, chunk_size, func);
+}
+
+void ThreadPool::run_each(int count, const std::function<void(int, int)>& func)
+{
+   run_chunks(0, count, 1, [&func](int first, int, int thread) {
+      func(first, thread);
+   });
+}
+
+void ThreadPool::run_chunks(int begin,
+                            int end,
+                            int chunk_size,
+                            const std::function<void(int, int, int)>& func)
+{
+   if (begin >= end) {
+      return;
+   }
+
+   // Give each thread a contiguous block of whole chunks, so that in the
+   // common case it walks memory sequentially and never touches the cache
+   // lines of its neighbors.
+   auto num_chunks = (end - begin + chunk_size - 1) / chunk_size;
+   for (auto i = 0; i < num_threads_; ++i) {
+      auto first_chunk = static_cast<long long>(num_chunks) * i / num_threads_;
+      auto last_chunk = static_cast<long long>(num_chunks) * (i + 1) /
+                        num_threads_;
+      blocks_[i].next.store(begin + static_cast<int>(first_chunk) * chunk_size,
+                            std::memory_order_relaxed);
+      blocks_[i].last = std::min(begin + static_cast<int>(last_chunk) *
+                                 chunk_size, end);
+   }
+
+   {
+      std::lock_guard<std::mutex> lock(mutex_);
+      func_ = &func;
+      chunk_size_ = chunk_size;
+      busy_ = num_threads_ - 1;
+      ++generation_;
+   }
+   start_.notify_all();
+
+   process(0);
+
+   std::unique_lock<std::mutex> lock(mutex_);
+   done_.wait(lock, [this] { return busy_ == 0; });
+   func_ = nullptr;
+}
+
+void ThreadPool::worker(int thread)
+{
+   unsigned generation = 0;
+   for (;;) {
+      {
+         std::unique_lock<std::mutex> lock(mutex_);
+         start_.wait(lock, [this, generation] {
+            return exit_ || (generation_ != generation);
+         });
+         if (exit_) {
+            return;
+         }
+         generation = generation_;
+      }
+
+      process(thread);
+
+      {
+         std::lock_guard<std::mutex> lock(mutex_);
+         if (--busy_ != 0) {
+            continue;
+         }
+      }
+      done_.notify_one();
+   }
+}
+
+void ThreadPool::process(int thread)
+{
+   // Start with our own block and then steal from the others in turn.
+   for (auto i = 0; i < num_threads_; ++i) {
+      auto& block = blocks_[(thread + i) % num_threads_];
+      for (;;) {
+         auto first = block.next.fetch_add(chunk_size_,
+                                           std::memory_order_relaxed);
+         if (first >= block.last) {
+            break;
+         }
+         (*func_)(first, std::min(first + chunk_size_, block.last), thread);
+      }
+   }
+}
@@ -0,0 +1,96 @@
+//
+// Copyright 2023 Stephen E. Bensley
+//
+// This file is licensed under the MIT License. You may obtain a copy of the
+// license at https://github.com/stephenbensley/FiveFieldKono/blob/main/LICENSE.
+//
+
+#ifndef ThreadPool_h
+#define ThreadPool_h
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Pool of persistent worker threads for running parallel loops. Unlike
+// parallel_for, the threads are reused from one loop to the next, so it's
+// suitable for loops that run many times.
+class ThreadPool
+{
+public:
+   // Number of indices in a chunk is always a multiple of this, so chunks of
+   // byte-sized elements span whole cache lines. Neighboring chunks only
+   // share the line at their boundary, and only if the array isn't aligned
+   // to a cache line.
+   static constexpr int chunk_alignment = 64;
+
+   // If num_threads is zero, uses one thread per hardware thread.
+   explicit ThreadPool(int num_threads = 0);
+   ~ThreadPool();
+
+   ThreadPool(const ThreadPool&) = delete;
+   ThreadPool& operator=(const ThreadPool&) = delete;
+
+   // Number of threads including the calling thread.
+   int size() const noexcept;
+
+   // Invokes func(first, last, thread) for contiguous chunks of [begin, end)
+   // and waits for all of them to complete. thread is in [0, size()). Each
+   // thread starts with its own block of chunks and steals from the others
+   // once its block is exhausted.
+   void run(int begin,
+            int end,
+            int chunk_size,
+            const std::function<void(int, int, int)>& func);
+   // Invokes func(index, thread) for every index in [0, count). Like run,
+   // but indices are handed out one at a time, for when each is a sizable
+   // task.
+   void run_each(int count, const std::function<void(int, int)>& func);
+
+private:
+   // Cursor over one thread's block of chunks. Padded, so that threads
+   // claiming chunks don't contend for the same cache line.
+   struct alignas(64) Block
+   {
+      std::atomic<int> next;
+      int last;
+   };
+
+   // Implements run without aligning the chunks.
+   void run_chunks(int begin,
+                   int end,
+                   int chunk_size,
+                   const std::function<void(int, int, int)>& func);
+   void worker(int thread);
+   void process(int thread);
+
+   const int num_threads_;
+   std::vector<std::thread> threads_;
+   std::unique_ptr<Block[]> blocks_;
+
+   // Describes the loop in progress.
+   const std::function<void(int, int, int)>* func_ = nullptr;
+   int chunk_size_ = 0;
+
+   std::mutex mutex_;
+   // Signals the workers that a new loop has started or that they should exit.
+   std::condition_variable start_;
+   // Signals the caller that the workers have finished the loop.
+   std::condition_variable done_;
+   // Incremented for every loop, so workers can tell when a new one starts.
+   unsigned generation_ = 0;
+   // Number of workers still processing the current loop.
+   int busy_ = 0;
+   bool exit_ = false;
+};
+
+inline int ThreadPool::size() const noexcept
+{
+   return num_threads_;
+}
+
+#endif /* ThreadPool_h */
@@ -0,0 +1,56 @@
+//
+// Copyright 2023 Stephen E. Bensley
+//
+// This file is licensed under the MIT License. You may obtain a copy of the
+// license at https://github.com/stephenbensley/FiveFieldKono/blob/main/LICENSE.
+//
+
+#include "catch.hpp"
+#include "BitMatrix.h"
+#include <random>
+
+TEST_CASE("transpose_block")
+{
+   std::mt19937_64 engine(1);
+   uint64_t block[BitMatrix::block_size];
+   uint64_t original[BitMatrix::block_size];
+   for (auto i = 0; i < BitMatrix::block_size; ++i) {
+      block[i] = original[i] = engine();
+   }
+   transpose_block(block);
+   for (auto i = 0; i < BitMatrix::block_size; ++i) {
+      for (auto j = 0; j < BitMatrix::block_size; ++j) {
+         CAPTURE(i, j);
+         CHECK(((block[i] >> j) & 1) == ((original[j] >> i) & 1));
+      }
+   }
+}
+
+TEST_CASE("BitMatrix::transpose")
+{
+   // Sizes that aren't multiples of the block size exercise the padding.
+   BitMatrix src(150, 70);
+   CHECK(src.rows() == 150);
+   CHECK(src.cols() == 70);
+   CHECK(src.words_per_row() == 2);
+   CHECK(src.block_rows() == 3);
+
+   std::mt19937 engine(1);
+   std::bernoulli_distribution dist(0.1);
+   for (auto i = 0; i < src.rows(); ++i) {
+      for (auto j = 0; j < src.cols(); ++j) {
+         if (dist(engine)) {
+            src.set(i, j);
+         }
+      }
+   }
+
+   BitMatrix dst(70, 150);
+   dst.transpose(src, 0, src.block_rows());
+   for (auto i = 0; i < src.rows(); ++i) {
+      for (auto j = 0; j < src.cols(); ++j) {
+         CAPTURE(i, j);
+         CHECK(src.test(i, j) == dst.test(j, i));
+      }
+   }
+}
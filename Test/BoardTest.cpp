@@ -7,6 +7,8 @@
 
 #include "catch.hpp"
 #include "Board.h"
+#include <algorithm>
+#include <limits>
 
 TEST_CASE("Cell::color")
 {
@@ -77,6 +79,28 @@ TEST_CASE("distance(Cells")
    while (std::next_permutation(lhs.begin(), lhs.end())) {
       CHECK(distance(lhs, rhs) == 3);
    }
+
+   // Same result as trying every permutation. Check all the white positions
+   // of the 5x5 game.
+   Board board(5,5);
+   Cells goal = board.cells(WHITE, 0b11'101'00'000'00);
+   for (auto combo : generate_combos(board.num_cells(WHITE), goal.size())) {
+      Cells cells;
+      for (auto index : combo) {
+         cells.push_back(board.cell(WHITE, index));
+      }
+
+      auto expected = std::numeric_limits<int>::max();
+      do {
+         auto total = 0;
+         for (auto i = 0; i < static_cast<int>(cells.size()); ++i) {
+            total += distance(cells[i], goal[i]);
+         }
+         expected = std::min(expected, total);
+      } while (std::next_permutation(cells.begin(), cells.end()));
+
+      CHECK(distance(cells, goal) == expected);
+   }
 }
 
 TEST_CASE("Board::num_cells")
@@ -212,3 +236,42 @@ TEST_CASE("Board::moves")
       }
    }
 }
+
+TEST_CASE("Board::moves(ColorBitBoard)")
+{
+   Board board(5,5);
+
+   SECTION("Matches Board::moves(Cells)") {
+      for (auto color : { BLACK, WHITE }) {
+         for (auto combo : generate_combos(board.num_cells(color), 3)) {
+            Cells from;
+            for (auto index : combo) {
+               from.push_back(board.cell(color, index));
+            }
+            auto expected = board.moves(from);
+
+            ColorMoves to;
+            auto count = board.moves(color, board.color_bitboard(from), 0, to);
+            REQUIRE(count == static_cast<int>(expected.size()));
+            CHECK(std::equal(expected.begin(), expected.end(), to.begin()));
+         }
+      }
+   }
+
+   SECTION("Blocked cells") {
+      // Black initial position with the center cell blocked.
+      Cells from = {{0,0}, {0,2}, {0,4}};
+      Cells expected[] = {
+         {{0,0}, {1,3}, {0,4}},
+         {{0,0}, {0,2}, {1,3}}
+      };
+      ColorMoves to;
+      auto count = board.moves(BLACK,
+                               board.color_bitboard(from),
+                               board.color_bitboard(Cells{{1,1}}),
+                               to);
+      REQUIRE(count == sizeof(expected)/sizeof(Cells));
+      CHECK(to[0] == board.color_bitboard(expected[0]));
+      CHECK(to[1] == board.color_bitboard(expected[1]));
+   }
+}
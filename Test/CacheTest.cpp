@@ -0,0 +1,188 @@
+//
+// Copyright 2023 Stephen E. Bensley
+//
+// This file is licensed under the MIT License. You may obtain a copy of the
+// license at https://github.com/stephenbensley/FiveFieldKono/blob/main/LICENSE.
+//
+
+#include "catch.hpp"
+#include "Cache.h"
+#include "Retrograde.h"
+#include <filesystem>
+#include <fstream>
+
+TEST_CASE("Cache")
+{
+   auto directory = std::filesystem::temp_directory_path() / "ffk_cache_test";
+   std::filesystem::remove_all(directory);
+   Cache cache(directory.c_str());
+   auto path = cache.path(3, 3, 0b111);
+
+   // The first request builds the graph and caches it.
+   auto built = cache.graph(3, 3, 0b111);
+   REQUIRE(built != nullptr);
+   REQUIRE(std::filesystem::exists(path));
+
+   // There's no strategy until one is saved.
+   Strategy empty(*built);
+   CHECK(!cache.load(empty));
+
+   Retrograde retro(*built);
+   retro.analyze();
+   cache.save(retro.strategy());
+
+   SECTION("Load graph and strategy") {
+      auto loaded = cache.graph(3, 3, 0b111);
+      REQUIRE(loaded != nullptr);
+      CHECK(loaded->size() == built->size());
+
+      Strategy strategy(*loaded);
+      REQUIRE(cache.load(strategy));
+      CHECK(strategy.hash() == retro.strategy().hash());
+   }
+
+   SECTION("Map strategy") {
+      auto mapped = cache.map(*built);
+      REQUIRE(mapped != nullptr);
+      CHECK(mapped->hash() == retro.strategy().hash());
+      auto start = built->start();
+      CHECK(mapped->best_move(start) == retro.strategy().best_move(start));
+   }
+
+   SECTION("Compact strategy") {
+      Retrograde compact(*built, 0, true);
+      compact.analyze();
+      cache.save(compact.strategy());
+
+      // A full strategy can't be loaded from a compact one.
+      Strategy full(*built);
+      CHECK(!cache.load(full));
+
+      Strategy loaded(*built, built->reachable());
+      REQUIRE(cache.load(loaded));
+      CHECK(loaded.hash() == compact.strategy().hash());
+
+      auto mapped = cache.map(*built);
+      REQUIRE(mapped != nullptr);
+      CHECK(mapped->compact());
+      CHECK(mapped->hash() == compact.strategy().hash());
+      auto start = built->start();
+      CHECK(mapped->best_move(start) == compact.strategy().best_move(start));
+   }
+
+   SECTION("Wide strategy") {
+      Strategy wide(*built);
+      for (auto i = 0; i < built->size(); ++i) {
+         wide.set_entry(i, retro.strategy().entry(i));
+      }
+      wide.widen();
+      cache.save(wide);
+
+      // Loading widens the strategy to match.
+      Strategy loaded(*built);
+      REQUIRE(cache.load(loaded));
+      CHECK(loaded.wide());
+      CHECK(loaded.hash() == wide.hash());
+
+      auto mapped = cache.map(*built);
+      REQUIRE(mapped != nullptr);
+      CHECK(mapped->wide());
+      CHECK(mapped->hash() == wide.hash());
+      auto start = built->start();
+      CHECK(mapped->best_move(start) == retro.strategy().best_move(start));
+   }
+
+   SECTION("Best moves") {
+      Retrograde moves(*built);
+      moves.analyze(Retrograde::QUEUE);
+      moves.add_best_moves();
+      cache.save(moves.strategy());
+
+      // Loading adds the table to match.
+      Strategy loaded(*built);
+      REQUIRE(cache.load(loaded));
+      CHECK(loaded.has_best_moves());
+      CHECK(loaded.hash() == moves.strategy().hash());
+
+      auto mapped = cache.map(*built);
+      REQUIRE(mapped != nullptr);
+      CHECK(mapped->has_best_moves());
+      CHECK(mapped->hash() == moves.strategy().hash());
+      auto start = built->start();
+      CHECK(mapped->best_move(start) == moves.strategy().best_move(start));
+   }
+
+   SECTION("Renumbered graph") {
+      Retrograde compact(*built, 0, true);
+      compact.analyze();
+      compact.add_best_moves();
+      cache.save(compact.strategy());
+
+      // An artifact from before renumbering is rewritten, with its strategy
+      // translated, when a renumbering cache reads the graph.
+      Cache renumbering(directory.c_str(), true);
+      auto graph = renumbering.graph(3, 3, 0b111);
+      REQUIRE(graph != nullptr);
+      REQUIRE(graph->renumbered());
+      Strategy loaded(*graph, graph->reachable());
+      REQUIRE(renumbering.load(loaded));
+      CHECK(loaded.wide() == compact.strategy().wide());
+      CHECK(loaded.has_best_moves());
+      for (auto i = 0; i < graph->size(); ++i) {
+         CAPTURE(i);
+         auto j = graph->original_index(i);
+         auto entry = loaded.entry(i);
+         auto expected = compact.strategy().entry(j);
+         CHECK(entry.empty() == expected.empty());
+         if (!entry.empty()) {
+            CHECK(entry.winner() == expected.winner());
+            CHECK(entry.depth() == expected.depth());
+         }
+         auto node = (*graph)[i];
+         if (!loaded.contains(i) || node.is_terminal()) {
+            continue;
+         }
+         auto move = loaded.best_move(node);
+         auto expected_move = compact.strategy().best_move((*built)[j]);
+         CHECK(graph->original_index(graph->index(move)) ==
+               built->index(expected_move));
+      }
+
+      // Any cache now reads the renumbered graph, and the strategy maps.
+      auto cached = cache.graph(3, 3, 0b111);
+      REQUIRE(cached != nullptr);
+      CHECK(cached->renumbered());
+      auto mapped = cache.map(*cached);
+      REQUIRE(mapped != nullptr);
+      CHECK(mapped->hash() == loaded.hash());
+
+      // The original graph no longer matches.
+      Strategy stale(*built, built->reachable());
+      CHECK(!cache.load(stale));
+   }
+
+   SECTION("Variants don't collide") {
+      CHECK(cache.path(3, 5, 0b111) != path);
+      CHECK(cache.path(3, 3, 0b11) != path);
+   }
+
+   SECTION("Corrupt artifact is rejected") {
+      {
+         std::fstream strm(path,
+                           std::ios::in | std::ios::out | std::ios::binary);
+         strm.seekp(-1, std::ios::end);
+         strm.put('\x7f');
+      }
+      Strategy strategy(*built);
+      CHECK(!cache.load(strategy));
+   }
+
+   SECTION("Mismatched graph is rejected") {
+      Graph other(3, 3, 0b101);
+      Strategy strategy(other);
+      CHECK(!cache.load(strategy));
+      CHECK(cache.map(other) == nullptr);
+   }
+
+   std::filesystem::remove_all(directory);
+}
@@ -7,6 +7,8 @@
 
 #include "catch.hpp"
 #include "ColorGraph.h"
+#include <algorithm>
+#include <sstream>
 
 TEST_CASE("ColorGraph::size")
 {
@@ -70,11 +72,11 @@ TEST_CASE("ColorGraph::start")
       //     X -
       //    X - X
       //
-      REQUIRE(start_node->player[0].moves.size() == 2);
-      CHECK(start_node->player[0].moves[0]->player[0].pieces == 0b000'00'000'01'110);
-      CHECK(start_node->player[0].moves[0]->player[1].pieces == 0b111'00'000'00'000);
-      CHECK(start_node->player[0].moves[1]->player[0].pieces == 0b000'00'000'01'101);
-      CHECK(start_node->player[0].moves[1]->player[1].pieces == 0b111'00'000'00'000);
+      REQUIRE(start_node->moves(0).size() == 2);
+      CHECK(start_node->moves(0)[0]->player[0].pieces == 0b000'00'000'01'110);
+      CHECK(start_node->moves(0)[0]->player[1].pieces == 0b111'00'000'00'000);
+      CHECK(start_node->moves(0)[1]->player[0].pieces == 0b000'00'000'01'101);
+      CHECK(start_node->moves(0)[1]->player[1].pieces == 0b111'00'000'00'000);
 
       // O's moves:
       //    O O -
@@ -89,11 +91,11 @@ TEST_CASE("ColorGraph::start")
       //     - -
       //    X X X
       //
-      REQUIRE(start_node->player[0].moves.size() == 2);
-      CHECK(start_node->player[1].moves[0]->player[1].pieces == 0b011'10'000'00'000);
-      CHECK(start_node->player[1].moves[0]->player[0].pieces == 0b000'00'000'00'111);
-      CHECK(start_node->player[1].moves[1]->player[1].pieces == 0b101'01'000'00'000);
-      CHECK(start_node->player[1].moves[1]->player[0].pieces == 0b000'00'000'00'111);
+      REQUIRE(start_node->moves(0).size() == 2);
+      CHECK(start_node->moves(1)[0]->player[1].pieces == 0b011'10'000'00'000);
+      CHECK(start_node->moves(1)[0]->player[0].pieces == 0b000'00'000'00'111);
+      CHECK(start_node->moves(1)[1]->player[1].pieces == 0b101'01'000'00'000);
+      CHECK(start_node->moves(1)[1]->player[0].pieces == 0b000'00'000'00'111);
    }
 
    SECTION("White initial position")
@@ -135,11 +137,11 @@ TEST_CASE("ColorGraph::start")
       //    - - X
       //     X X
       //
-      REQUIRE(start_node->player[0].moves.size() == 2);
-      CHECK(start_node->player[0].moves[0]->player[0].pieces == 0b00'000'00'111'01);
-      CHECK(start_node->player[0].moves[0]->player[1].pieces == 0b11'101'00'000'00);
-      CHECK(start_node->player[0].moves[1]->player[0].pieces == 0b00'000'01'100'11);
-      CHECK(start_node->player[0].moves[1]->player[1].pieces == 0b11'101'00'000'00);
+      REQUIRE(start_node->moves(0).size() == 2);
+      CHECK(start_node->moves(0)[0]->player[0].pieces == 0b00'000'00'111'01);
+      CHECK(start_node->moves(0)[0]->player[1].pieces == 0b11'101'00'000'00);
+      CHECK(start_node->moves(0)[1]->player[0].pieces == 0b00'000'01'100'11);
+      CHECK(start_node->moves(0)[1]->player[1].pieces == 0b11'101'00'000'00);
 
       // O's moves:
       //     O O
@@ -154,10 +156,128 @@ TEST_CASE("ColorGraph::start")
       //    X - X
       //     X X
       //
-      REQUIRE(start_node->player[0].moves.size() == 2);
-      CHECK(start_node->player[1].moves[0]->player[1].pieces == 0b11'001'10'000'00);
-      CHECK(start_node->player[1].moves[0]->player[0].pieces == 0b00'000'00'101'11);
-      CHECK(start_node->player[1].moves[1]->player[1].pieces == 0b01'111'00'000'00);
-      CHECK(start_node->player[1].moves[1]->player[0].pieces == 0b00'000'00'101'11);
+      REQUIRE(start_node->moves(0).size() == 2);
+      CHECK(start_node->moves(1)[0]->player[1].pieces == 0b11'001'10'000'00);
+      CHECK(start_node->moves(1)[0]->player[0].pieces == 0b00'000'00'101'11);
+      CHECK(start_node->moves(1)[1]->player[1].pieces == 0b01'111'00'000'00);
+      CHECK(start_node->moves(1)[1]->player[0].pieces == 0b00'000'00'101'11);
    }
 }
+
+TEST_CASE("ColorGraph::node")
+{
+   ColorPosition start_pos = {
+      0b000'00'000'00'111,
+      0b111'00'000'00'000
+   };
+   ColorGraph graph({5,5}, BLACK, start_pos);
+   CHECK(graph.node(start_pos[0], start_pos[1]) == graph.start());
+
+   // A combination and its reflection map to the same node.
+   //    O O O
+   //     - -
+   //    - - -
+   //     X -
+   //    - X X
+   CHECK(graph.node(0b000'00'000'01'110, start_pos[1]) ==
+         graph.node(0b000'00'000'10'011, start_pos[1]));
+
+   // Every node can be found from its pieces.
+   for (auto i = 0; i < graph.size(); ++i) {
+      auto node = graph[i];
+      CHECK(graph.node(node->player[0].pieces, node->player[1].pieces) == node);
+   }
+}
+
+TEST_CASE("ColorGraph columns")
+{
+   ColorPosition start_pos = {
+      0b000'00'000'00'111,
+      0b111'00'000'00'000
+   };
+   ColorGraph built({5,5}, BLACK, start_pos);
+   std::stringstream strm;
+   built.save(strm);
+   ColorGraph loaded;
+   REQUIRE(loaded.load(strm));
+   ColorGraph renumbered({5,5}, BLACK, start_pos);
+   renumbered.renumber();
+
+   for (auto graph : { &built, &loaded, &renumbered }) {
+      for (auto i = 0; i < graph->size(); ++i) {
+         INFO("node " << i);
+         auto node = (*graph)[i];
+         auto word = i / 64;
+         auto bit = uint64_t(1) << (i % 64);
+         for (auto j = 0; j < num_players; ++j) {
+            auto& player = node->player[j];
+            CHECK(graph->distances(j)[i] == player.distance);
+            CHECK(graph->num_moves(j)[i] == player.num_moves);
+            CHECK(((graph->goal_reached(j)[word] & bit) != 0) ==
+                  player.goal_reached);
+            CHECK(((graph->goal_full(j)[word] & bit) != 0) ==
+                  player.goal_full);
+         }
+      }
+   }
+}
+
+TEST_CASE("ColorGraph::renumber")
+{
+   ColorPosition start_pos = {
+      0b000'00'000'00'111,
+      0b111'00'000'00'000
+   };
+   ColorGraph original({5,5}, BLACK, start_pos);
+   ColorGraph graph({5,5}, BLACK, start_pos);
+   CHECK(!graph.renumbered());
+   graph.renumber();
+   REQUIRE(graph.renumbered());
+   REQUIRE(graph.size() == original.size());
+   // The search starts from the start.
+   CHECK(graph.start()->index == 0);
+   CHECK(graph.original_index(0) == original.start()->index);
+
+   // Same nodes and same moves in the same order, just numbered differently.
+   std::vector<bool> seen(graph.size());
+   for (auto i = 0; i < graph.size(); ++i) {
+      CAPTURE(i);
+      auto node = graph[i];
+      auto j = graph.original_index(i);
+      seen[j] = true;
+      auto expected = original[j];
+      for (auto k = 0; k < num_players; ++k) {
+         CHECK(node->player[k].pieces == expected->player[k].pieces);
+         auto moves = node->moves(k);
+         auto expected_moves = expected->moves(k);
+         REQUIRE(moves.size() == expected_moves.size());
+         for (auto m = 0; m < moves.size(); ++m) {
+            CHECK(graph.original_index(moves[m]->index) ==
+                  expected_moves[m]->index);
+         }
+      }
+      CHECK(graph.node(node->player[0].pieces, node->player[1].pieces) ==
+            node);
+   }
+   CHECK(std::all_of(seen.begin(), seen.end(), [](bool s) { return s; }));
+
+   // The original indices survive a round trip.
+   std::stringstream strm;
+   graph.save(strm);
+   ColorGraph loaded;
+   REQUIRE(loaded.load(strm, true));
+   CHECK(loaded.renumbered());
+   for (auto i = 0; i < graph.size(); ++i) {
+      CAPTURE(i);
+      CHECK(loaded.original_index(i) == graph.original_index(i));
+   }
+}
+
+TEST_CASE("binomial")
+{
+   CHECK(binomial(0, 0) == 1);
+   CHECK(binomial(5, 2) == 10);
+   CHECK(binomial(13, 3) == 286);
+   CHECK(binomial(16, 8) == 12870);
+   CHECK(binomial(3, 4) == 0);
+}
@@ -7,6 +7,10 @@
 
 #include "catch.hpp"
 #include "Graph.h"
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <sstream>
 
 TEST_CASE("Graph::node")
 {
@@ -50,3 +54,324 @@ TEST_CASE("Graph::index")
    auto start_b = graph[graph.index(start_a)];
    CHECK(start_a == start_b);
 }
+
+TEST_CASE("Node::unmoves")
+{
+   // Every move must be undone by one of the resulting node's unmoves.
+   Graph graph(3, 3, 0b111);
+   for (auto i = 0; i < graph.size(); ++i) {
+      auto node = graph[i];
+      CHECK(node.num_moves() == static_cast<int>(node.moves().size()));
+      for (auto move : node.moves()) {
+         auto unmoves = move.unmoves();
+         CHECK(std::find(unmoves.begin(), unmoves.end(), node) !=
+               unmoves.end());
+      }
+   }
+}
+
+TEST_CASE("Node::move/for_each_move")
+{
+   Graph graph(3, 3, 0b111);
+   for (auto i = 0; i < graph.size(); ++i) {
+      CAPTURE(i);
+      auto node = graph[i];
+      auto moves = node.moves();
+      std::vector<Node> visited;
+      node.for_each_move([&](const Node& move) {
+         visited.push_back(move);
+      });
+      REQUIRE(visited.size() == moves.size());
+      for (auto k = 0; k < static_cast<int>(moves.size()); ++k) {
+         CAPTURE(k);
+         CHECK(node.move(k) == moves[k]);
+         CHECK(visited[k] == moves[k]);
+      }
+   }
+}
+
+TEST_CASE("NodeId")
+{
+   CHECK(sizeof(NodeId) == 4);
+
+   Graph graph(5, 3, 0b11111);
+   for (auto i = 0; i < graph.size(); ++i) {
+      CAPTURE(i);
+      auto node = graph[i];
+      auto id = graph.id(node);
+      CHECK(id.index() == i);
+      CHECK(graph[id] == node);
+      CHECK(graph.player(id) == node.player());
+      auto [b_idx, w_idx] = node.indices();
+      CHECK(graph.player(b_idx, w_idx) == node.player());
+      CHECK(graph.indices(id) == std::pair<int, int>(node.indices()));
+      if (node.is_terminal()) {
+         continue;
+      }
+      std::vector<NodeId> moves;
+      graph.for_each_move(id, [&](NodeId move) {
+         moves.push_back(move);
+      });
+      auto expected = node.moves();
+      REQUIRE(moves.size() == expected.size());
+      for (auto k = 0; k < static_cast<int>(moves.size()); ++k) {
+         CAPTURE(k);
+         CHECK(graph[moves[k]] == expected[k]);
+      }
+   }
+}
+
+TEST_CASE("Graph terminals")
+{
+   Graph built(5, 3, 0b11111);
+   std::stringstream strm;
+   built.save(strm);
+   auto loaded = Graph::load(strm, 5, 3);
+   REQUIRE(loaded);
+
+   for (auto graph : { &built, loaded.get() }) {
+      auto num_white = graph->white().size();
+      int counts[3] = { 0, 0, 0 };
+      for (auto i = 0; i < graph->size(); ++i) {
+         CAPTURE(i);
+         auto node = (*graph)[i];
+         auto expected = -1;
+         if (node.is_winner(0)) {
+            expected = 0;
+         } else if (node.is_winner(1)) {
+            expected = 1;
+         } else if (node.no_moves()) {
+            expected = other_player(node.player());
+            ++counts[2];
+         }
+         auto winner = graph->terminal_winner(NodeId(i));
+         CHECK(winner == expected);
+         CHECK(graph->is_terminal(NodeId(i)) == node.is_terminal());
+         if (winner >= 0) {
+            ++counts[winner];
+         }
+
+         auto [b_idx, w_idx] = node.indices();
+         auto wins = graph->terminal_wins(b_idx, w_idx / 64);
+         auto bit = uint64_t(1) << (w_idx % 64);
+         for (auto j = 0; j < num_players; ++j) {
+            CHECK(((wins[j] & bit) != 0) == (expected == j));
+         }
+      }
+      CHECK(counts[0] > 0);
+      CHECK(counts[1] > 0);
+      CHECK(counts[2] > 0);
+      CHECK(num_white > 64);
+   }
+}
+
+TEST_CASE("Graph::renumber")
+{
+   Graph original(5, 3, 0b11111);
+   Graph graph(5, 3, 0b11111);
+   graph.renumber();
+   REQUIRE(graph.renumbered());
+   REQUIRE(graph.size() == original.size());
+   CHECK(graph.original_index(graph.index(graph.start())) ==
+         original.index(original.start()));
+
+   for (auto i = 0; i < graph.size(); ++i) {
+      CAPTURE(i);
+      auto node = graph[i];
+      auto expected = original[graph.original_index(i)];
+      CHECK(node.player() == expected.player());
+      CHECK(graph.terminal_winner(NodeId(i)) ==
+            original.terminal_winner(original.id(expected)));
+      if (node.is_terminal()) {
+         continue;
+      }
+      auto moves = node.moves();
+      auto expected_moves = expected.moves();
+      REQUIRE(moves.size() == expected_moves.size());
+      for (auto k = 0; k < static_cast<int>(moves.size()); ++k) {
+         CAPTURE(k);
+         CHECK(graph.original_index(graph.index(moves[k])) ==
+               original.index(expected_moves[k]));
+      }
+   }
+
+   std::stringstream strm;
+   graph.save(strm);
+   auto loaded = Graph::load(strm, 5, 3, true);
+   REQUIRE(loaded);
+   CHECK(loaded->renumbered());
+   CHECK(loaded->original_index(7) == graph.original_index(7));
+}
+
+TEST_CASE("Graph::save/load")
+{
+   Graph graph(3, 3, 0b111);
+   std::stringstream strm;
+   graph.save(strm);
+
+   SECTION("Round trip") {
+      auto loaded = Graph::load(strm, 3, 3);
+      REQUIRE(loaded != nullptr);
+      REQUIRE(loaded->size() == graph.size());
+      CHECK(graph.index(graph.start()) == loaded->index(loaded->start()));
+      for (auto i = 0; i < graph.size(); ++i) {
+         auto expected = graph[i];
+         auto actual = (*loaded)[i];
+         CHECK(actual.player() == expected.player());
+         CHECK(actual.position(loaded->board()) ==
+               expected.position(graph.board()));
+         CHECK(actual.num_moves() == expected.num_moves());
+         CHECK(actual.is_terminal() == expected.is_terminal());
+      }
+   }
+
+   SECTION("Truncated") {
+      auto bytes = strm.str();
+      std::stringstream truncated(bytes.substr(0, bytes.size() / 2));
+      CHECK(Graph::load(truncated, 3, 3) == nullptr);
+   }
+
+   SECTION("Corrupt count") {
+      // The black graph's edge count follows its header and nodes.
+      auto bytes = strm.str();
+      auto offset = 3 * sizeof(int) + sizeof(uint64_t) +
+                    graph.black().size() * num_players * 8;
+      uint64_t count = ~uint64_t(0);
+      bytes.replace(offset,
+                    sizeof(count),
+                    reinterpret_cast<const char*>(&count),
+                    sizeof(count));
+      std::stringstream corrupt(bytes);
+      CHECK(Graph::load(corrupt, 3, 3) == nullptr);
+   }
+}
+
+TEST_CASE("Graph player swap")
+{
+   // Swapping the players and reflecting the board preserves parity, so the
+   // same player moves next. See the comment on Strategy.
+   Graph graph(5, 3, 0b11111);
+   auto& board = graph.board();
+   for (auto i = 0; i < graph.size(); ++i) {
+      auto node = graph[i];
+      auto pos = node.position(board);
+      auto black = board.reflect_y(board.cells(pos[1]));
+      auto white = board.reflect_y(board.cells(pos[0]));
+      auto swapped = graph.node(board.bitboard(black), board.bitboard(white));
+      CHECK(swapped.player() == node.player());
+   }
+}
+
+TEST_CASE("Graph::tile")
+{
+   Graph graph(5, 3, 0b11111);
+   auto num_white = graph.white().size();
+   // Shapes that don't evenly divide the graph exercise the partial tiles.
+   for (auto [rows, cols] : { std::pair{ 1, 1 }, { 7, 64 }, { 1000, 1000 } }) {
+      CAPTURE(rows, cols);
+      std::vector<int> visits(graph.size());
+      for (auto i = 0; i < graph.num_tiles(rows, cols); ++i) {
+         auto tile = graph.tile(i, rows, cols);
+         CHECK(tile.black_end - tile.black_begin <= rows);
+         CHECK(tile.white_end - tile.white_begin <= cols);
+         for (auto b = tile.black_begin; b < tile.black_end; ++b) {
+            for (auto w = tile.white_begin; w < tile.white_end; ++w) {
+               ++visits[b * num_white + w];
+            }
+         }
+      }
+      CHECK(std::all_of(visits.begin(), visits.end(), [](int v) {
+         return v == 1;
+      }));
+   }
+}
+
+TEST_CASE("Graph::reachable")
+{
+   for (auto [width, start0] : { std::pair{ 3, 0b111 }, { 5, 0b11111 } }) {
+      Graph graph(width, 3, start0);
+      auto reachable = graph.reachable();
+
+      // Compare against a simple serial search.
+      std::vector<bool> expected(graph.size());
+      std::vector<int> stack = { graph.index(graph.start()) };
+      expected[stack.back()] = true;
+      while (!stack.empty()) {
+         auto node = graph[stack.back()];
+         stack.pop_back();
+         if (node.is_terminal()) {
+            continue;
+         }
+         for (auto move : node.moves()) {
+            auto index = graph.index(move);
+            if (!expected[index]) {
+               expected[index] = true;
+               stack.push_back(index);
+            }
+         }
+      }
+
+      for (auto i = 0; i < graph.size(); ++i) {
+         CAPTURE(i);
+         CHECK(reachable.contains(i) == expected[i]);
+      }
+      CHECK(reachable.count() ==
+            std::count(expected.begin(), expected.end(), true));
+   }
+}
+
+// Compares the cost of looking up every successor's entry when the nodes are
+// visited in different orders. Hidden, since it's slow; run it with the
+// [benchmark] tag, preferably under a profiler that counts cache misses.
+TEST_CASE("Graph traversal", "[.][benchmark]")
+{
+   Graph graph(5, 5, 0b11111);
+   std::vector<char> entries(graph.size());
+   auto num_white = graph.white().size();
+
+   auto successors = [&](const Node& node) {
+      auto [b_idx, w_idx] = node.indices();
+      auto sum = 0;
+      for (auto move : graph.black()[b_idx]->moves(node.player())) {
+         sum += entries[move->index * num_white + w_idx];
+      }
+      for (auto move : graph.white()[w_idx]->moves(node.player())) {
+         sum += entries[b_idx * num_white + move->index];
+      }
+      return sum;
+   };
+   auto measure = [&](const char* name, auto traverse) {
+      auto begin = std::chrono::steady_clock::now();
+      traverse();
+      std::chrono::duration<double, std::nano> elapsed =
+         std::chrono::steady_clock::now() - begin;
+      std::cout << name << ": " << elapsed.count() / graph.size()
+                << " ns/node" << std::endl;
+   };
+
+   auto sum = 0;
+   // Eight workers each taking every eighth node.
+   measure("strided", [&] {
+      for (auto worker = 0; worker < 8; ++worker) {
+         for (auto i = worker; i < graph.size(); i += 8) {
+            sum += successors(graph[i]);
+         }
+      }
+   });
+   measure("rows", [&] {
+      for (auto i = 0; i < graph.size(); ++i) {
+         sum += successors(graph[i]);
+      }
+   });
+   measure("tiles", [&] {
+      for (auto i = 0; i < graph.num_tiles(256, 64); ++i) {
+         auto tile = graph.tile(i, 256, 64);
+         for (auto b = tile.black_begin; b < tile.black_end; ++b) {
+            for (auto w = tile.white_begin; w < tile.white_end; ++w) {
+               sum += successors(graph[b * num_white + w]);
+            }
+         }
+      }
+   });
+   CHECK(sum == 0);
+}
@@ -0,0 +1,33 @@
+//
+// Copyright 2023 Stephen E. Bensley
+//
+// This file is licensed under the MIT License. You may obtain a copy of the
+// license at https://github.com/stephenbensley/FiveFieldKono/blob/main/LICENSE.
+//
+
+#include "catch.hpp"
+#include "NodeSet.h"
+
+TEST_CASE("NodeSet")
+{
+   // Spans several words and ends in a partial one.
+   NodeSet nodes(200);
+   for (auto i = 0; i < nodes.size(); i += 3) {
+      nodes.insert(i);
+   }
+   CHECK(nodes.try_insert(199));
+   CHECK(!nodes.try_insert(199));
+   nodes.build_index();
+
+   CHECK(nodes.count() == 68);
+   auto rank = 0;
+   for (auto i = 0; i < nodes.size(); ++i) {
+      CAPTURE(i);
+      CHECK(nodes.contains(i) == ((i % 3 == 0) || (i == 199)));
+      CHECK(nodes.rank(i) == rank);
+      if (nodes.contains(i)) {
+         CHECK(nodes.select(rank) == i);
+         ++rank;
+      }
+   }
+}
@@ -0,0 +1,148 @@
+//
+// Copyright 2023 Stephen E. Bensley
+//
+// This file is licensed under the MIT License. You may obtain a copy of the
+// license at https://github.com/stephenbensley/FiveFieldKono/blob/main/LICENSE.
+//
+
+#include "catch.hpp"
+#include "Retrograde.h"
+
+TEST_CASE("Retrograde algorithms")
+{
+   // 4x3 solves nearly every node, so it also exercises the worklist.
+   struct Variant { int width; int height; BitBoard start0; };
+   for (auto variant : { Variant{ 4, 3, 0b1111 }, Variant{ 5, 3, 0b11111 } }) {
+      Graph graph(variant.width, variant.height, variant.start0);
+      Retrograde queue(graph);
+      queue.analyze(Retrograde::QUEUE);
+
+      // The other deterministic algorithms should match the queue exactly no
+      // matter how many threads are used.
+      for (auto algorithm : { Retrograde::LOCKSTEP,
+                              Retrograde::BITWISE,
+                              Retrograde::SCC }) {
+         for (auto num_threads : { 1, 4 }) {
+            Retrograde retro(graph, num_threads);
+            retro.analyze(algorithm);
+            for (auto i = 0; i < graph.size(); ++i) {
+               CAPTURE(algorithm, num_threads, i);
+               CHECK(retro.strategy().entry(i).value() ==
+                     queue.strategy().entry(i).value());
+            }
+         }
+      }
+
+      // A sweep's depths depend on timing, but the winners don't.
+      Retrograde sweep(graph, 4);
+      sweep.analyze(Retrograde::SWEEP);
+      for (auto i = 0; i < graph.size(); ++i) {
+         CAPTURE(i);
+         auto a = sweep.strategy().entry(i);
+         auto b = queue.strategy().entry(i);
+         CHECK(a.empty() == b.empty());
+         CHECK(a.winner() == b.winner());
+      }
+   }
+}
+
+TEST_CASE("Retrograde reachable only")
+{
+   // Only 17 of the 3x3 nodes are reachable, so most are skipped.
+   struct Variant { int width; int height; BitBoard start0; };
+   for (auto variant : { Variant{ 3, 3, 0b111 }, Variant{ 4, 3, 0b1111 } }) {
+      Graph graph(variant.width, variant.height, variant.start0);
+      auto reachable = graph.reachable();
+      Retrograde full(graph);
+      full.analyze(Retrograde::QUEUE);
+
+      for (auto algorithm : { Retrograde::LOCKSTEP,
+                              Retrograde::BITWISE,
+                              Retrograde::SCC,
+                              Retrograde::QUEUE }) {
+         Retrograde retro(graph, 1, true);
+         CHECK(retro.analyze(algorithm) ==
+               full.strategy().entry(graph.index(graph.start())).value());
+         CHECK(retro.strategy().num_entries() == reachable.count());
+         for (auto i = 0; i < graph.size(); ++i) {
+            CAPTURE(algorithm, i);
+            auto expected = reachable.contains(i) ? full.strategy().entry(i)
+                                                  : Strategy::Entry{};
+            CHECK(retro.strategy().entry(i).value() == expected.value());
+         }
+      }
+
+      // Sweep's depths vary, but the start's winner doesn't.
+      Retrograde sweep(graph, 4, true);
+      sweep.analyze(Retrograde::SWEEP);
+      auto start = graph.index(graph.start());
+      CHECK(sweep.strategy().entry(start).winner() ==
+            full.strategy().entry(start).winner());
+   }
+}
+
+TEST_CASE("Retrograde widening")
+{
+   Graph graph(5, 3, 0b11111);
+   Retrograde queue(graph);
+   queue.analyze(Retrograde::QUEUE);
+   REQUIRE(!queue.strategy().wide());
+
+   // Widen partway through, so some entries are stored narrow and the rest
+   // wide.
+   auto deepest = 0;
+   for (auto i = 0; i < graph.size(); ++i) {
+      auto entry = queue.strategy().entry(i);
+      if (!entry.empty()) {
+         deepest = std::max(deepest, entry.depth());
+      }
+   }
+   auto widen_depth = deepest / 2;
+   REQUIRE(widen_depth > 0);
+
+   for (auto algorithm : { Retrograde::SWEEP,
+                           Retrograde::LOCKSTEP,
+                           Retrograde::BITWISE,
+                           Retrograde::SCC,
+                           Retrograde::QUEUE }) {
+      Retrograde retro(graph, 4);
+      retro.set_widen_depth(widen_depth);
+      retro.analyze(algorithm);
+      CHECK(retro.strategy().wide());
+      for (auto i = 0; i < graph.size(); ++i) {
+         CAPTURE(algorithm, i);
+         auto a = retro.strategy().entry(i);
+         auto b = queue.strategy().entry(i);
+         // A sweep's depths depend on timing, but the winners don't.
+         if (algorithm == Retrograde::SWEEP) {
+            CHECK(a.empty() == b.empty());
+            CHECK(a.winner() == b.winner());
+         } else {
+            CHECK(a.value() == b.value());
+         }
+      }
+   }
+}
+
+TEST_CASE("Retrograde::component_stats")
+{
+   Graph graph(5, 3, 0b11111);
+   Retrograde retro(graph);
+   retro.analyze(Retrograde::SCC);
+   auto& stats = retro.component_stats();
+
+   // Every node is in exactly one component.
+   CHECK(stats.single_nodes + stats.cyclic_nodes == graph.size());
+   int64_t num_components = 0;
+   for (auto size : stats.sizes) {
+      num_components += size;
+   }
+   CHECK(num_components == stats.components);
+   CHECK(stats.largest <= stats.cyclic_nodes);
+   CHECK(stats.cyclic_seconds <= stats.total_seconds);
+
+   // Most of the graph is one component, but the search's memory still only
+   // depends on the number of nodes, not edges.
+   CHECK(stats.largest > graph.size() / 2);
+   CHECK(stats.peak_bytes <= 12 * int64_t(graph.size()));
+}
@@ -0,0 +1,108 @@
+//
+// Copyright 2023 Stephen E. Bensley
+//
+// This file is licensed under the MIT License. You may obtain a copy of the
+// license at https://github.com/stephenbensley/FiveFieldKono/blob/main/LICENSE.
+//
+
+#include "catch.hpp"
+#include "Retrograde.h"
+#include <sstream>
+
+TEST_CASE("Strategy::Entry")
+{
+   CHECK(Strategy::Entry8::max_depth() == 126);
+   CHECK(Strategy::Entry16::max_depth() == 32766);
+
+   Strategy::Entry16 deep(1, 1000);
+   CHECK(deep.winner() == 1);
+   CHECK(deep.depth() == 1000);
+
+   // Converting keeps the value as long as it fits.
+   Strategy::Entry8 narrow(Strategy::Entry16(0, 126));
+   CHECK(narrow.winner() == 0);
+   CHECK(narrow.depth() == 126);
+   CHECK(Strategy::Entry16(narrow).value() == narrow.value());
+   CHECK(Strategy::Entry8(Strategy::Entry16{}).empty());
+}
+
+TEST_CASE("Strategy::widen")
+{
+   Graph graph(4, 3, 0b1111);
+   Retrograde retro(graph);
+   retro.analyze(Retrograde::QUEUE);
+   auto& solved = retro.strategy();
+   CHECK(!solved.wide());
+   CHECK(solved.max_depth() == Strategy::Entry8::max_depth());
+
+   Strategy strategy(graph);
+   for (auto i = 0; i < graph.size(); ++i) {
+      strategy.set_entry(i, solved.entry(i));
+   }
+   strategy.widen();
+   CHECK(strategy.wide());
+   CHECK(strategy.max_depth() == Strategy::Entry16::max_depth());
+   CHECK(strategy.bytes() == 2 * solved.bytes());
+
+   // Widening keeps the contents, and deeper entries can now be stored.
+   for (auto i = 0; i < graph.size(); ++i) {
+      CAPTURE(i);
+      CHECK(strategy.entry(i).value() == solved.entry(i).value());
+   }
+   strategy.set_entry(1, { 1, 1000 });
+   CHECK(strategy.entry(1).depth() == 1000);
+
+   // A wide strategy loads into one that's already wide.
+   std::stringstream strm;
+   strategy.save(strm);
+   Strategy loaded(graph);
+   loaded.widen();
+   REQUIRE(loaded.load(strm));
+   CHECK(loaded.hash() == strategy.hash());
+}
+
+TEST_CASE("Strategy best-move table")
+{
+   Graph graph(5, 3, 0b11111);
+   Retrograde retro(graph);
+   retro.analyze(Retrograde::QUEUE);
+   auto& strategy = retro.strategy();
+   CHECK(!strategy.has_best_moves());
+
+   // Without the table, best_move searches.
+   std::vector<Node> searched(graph.size());
+   for (auto i = 0; i < graph.size(); ++i) {
+      if (!graph[i].is_terminal()) {
+         searched[i] = strategy.best_move(graph[i]);
+      }
+   }
+
+   retro.add_best_moves();
+   REQUIRE(strategy.has_best_moves());
+   CHECK(strategy.layout().best_moves);
+
+   // The table picks the same moves, and none can be improved upon.
+   for (auto i = 0; i < graph.size(); ++i) {
+      auto node = graph[i];
+      if (node.is_terminal()) {
+         continue;
+      }
+      CAPTURE(i);
+      auto best = strategy.best_move(node);
+      CHECK(best == searched[i]);
+      auto color = node.player() ? -1 : +1;
+      auto value = color * strategy.entry(graph.index(best)).value();
+      for (auto move : node.moves()) {
+         CHECK(color * strategy.entry(graph.index(move)).value() <= value);
+      }
+   }
+
+   // The table is saved along with the entries.
+   std::stringstream strm;
+   strategy.save(strm);
+   CHECK(strm.str().size() == strategy.bytes());
+   Strategy loaded(graph);
+   loaded.add_best_moves();
+   REQUIRE(loaded.load(strm));
+   CHECK(loaded.hash() == strategy.hash());
+}
@@ -0,0 +1,52 @@
+//
+// Copyright 2023 Stephen E. Bensley
+//
+// This file is licensed under the MIT License. You may obtain a copy of the
+// license at https://github.com/stephenbensley/FiveFieldKono/blob/main/LICENSE.
+//
+
+#include "catch.hpp"
+#include "ThreadPool.h"
+#include <atomic>
+#include <vector>
+
+TEST_CASE("ThreadPool::run")
+{
+   ThreadPool pool(4);
+   CHECK(pool.size() == 4);
+
+   // Reuse the pool for several loops of varying sizes.
+   for (auto size : { 1, 63, 64, 1000, 100'000 }) {
+      // Catch isn't thread-safe, so record the results and check them after.
+      std::vector<std::atomic<int>> visits(size + 10);
+      std::atomic<int> misaligned = 0;
+      pool.run(10, size + 10, 100, [&](int first, int last, int) {
+         // Chunks are aligned relative to begin.
+         if (((first - 10) % ThreadPool::chunk_alignment) != 0) {
+            ++misaligned;
+         }
+         for (auto i = first; i < last; ++i) {
+            ++visits[i];
+         }
+      });
+      CHECK(misaligned == 0);
+      for (auto i = 0; i < static_cast<int>(visits.size()); ++i) {
+         CHECK(visits[i] == ((i < 10) ? 0 : 1));
+      }
+   }
+}
+
+TEST_CASE("ThreadPool single thread")
+{
+   ThreadPool pool(1);
+   auto sum = 0LL;
+   auto max_thread = 0;
+   pool.run(0, 10'000, 64, [&](int first, int last, int thread) {
+      max_thread = std::max(max_thread, thread);
+      for (auto i = first; i < last; ++i) {
+         sum += i;
+      }
+   });
+   CHECK(max_thread == 0);
+   CHECK(sum == 10'000LL * 9'999 / 2);
+}